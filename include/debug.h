@@ -4,15 +4,40 @@
 #include <stdlib.h>
 #include "types.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Logger
+void logger_flush();
+void logger_init(const char *filename);
+void logger_shutdown();
+void logger_write(
+    LogSite *site, LogLevel level, const char *func, const char *format, ...
+)
+#ifdef __GNUC__
+__attribute__((format(printf, 4, 5)))
+#endif
+;
+
+#ifdef __cplusplus
+}
+#endif
+
+#define log_at(level, ...)do{static LogSite _log_site={__FILE__,__LINE__,0,0,0};logger_write(&_log_site,(level),__func__,__VA_ARGS__);}while(0)
+#define log_info(...)log_at(LOG_INFO,__VA_ARGS__)
+#define log_warn(...)log_at(LOG_WARN,__VA_ARGS__)
+#define log_error(...)log_at(LOG_ERROR,__VA_ARGS__)
+
 #ifndef NDEBUG
-#define assert_ok(a, msg)if(!(a)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_not(a, msg)if((a)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_eq(a, b, msg)if((a)!=(b)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_gt(a, b, msg)if((a)<=(b)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_gte(a, b, msg)if((a)<(b)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_lt(a, b, msg)if((a)>=(b)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define assert_lte(a, b, msg)if((a)>(b)){fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
-#define log(...)fprintf(stderr,"notice: %s:%d %s()\n\t",__FILE__,__LINE__,__func__);fprintf(stderr,__VA_ARGS__);fprintf(stderr,"\n\n");
+#define assert_ok(a, msg)if(!(a)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_not(a, msg)if((a)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_eq(a, b, msg)if((a)!=(b)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_gt(a, b, msg)if((a)<=(b)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_gte(a, b, msg)if((a)<(b)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_lt(a, b, msg)if((a)>=(b)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define assert_lte(a, b, msg)if((a)>(b)){logger_flush();fprintf(stderr,"error: %s:%d %s()\n\t%s\n\n",__FILE__,__LINE__,__func__,(msg));abort();}
+#define log(...)log_at(LOG_DEBUG,__VA_ARGS__)
 #define log_fps(frame, time, base){printf("FPS: %4.2f\n",frame*1000.0f/(time-base));}
 #else
 #define assert_ok(a, msg)((void)0)
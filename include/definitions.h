@@ -1,19 +1,53 @@
 #pragma once
 
 // Configurable
+#define DRAW_DISTANCE (WORLD_XZ * 2)
 #define GAME_SPEED 2
+#define GEN_ROUGHNESS 50
 #define HUMAN_COUNT 4
 #define LANDER_ATTACK_RANGE 14
 #define LANDER_COUNT 12
 #define LANDER_SEARCH_RANGE 6
 #define LETHAL_FALL_HEIGHT 8
+#define LIGHT_AMBIENT 0.16f
+#define LIGHT_SUN 0.26f
+#define LOD_FAR_RADIUS 64
+#define LOD_NEAR_RADIUS 32
+#define OCTREE_DEPTH 8
+#define OCTREE_LEAF 8
+#define STREAM_BUDGET_MB 16
+#define STRESS_LANDER_COUNT 2000
 #define WORLD_XZ 100
 #define WORLD_Y 50
 
 // Non-configurable
+#define BENCH_PITCH 20
+#define BENCH_PROBES 4096
+#define DRIFT_EPSILON 0.0001f
+#define IDLE_SLEEP_MAX 16
+#define JOBS_MAX_SUCCESSORS 8
+#define JOBS_MAX_WORKERS 64
+#define JOBS_QUEUE_SIZE 1024
+#define LASER_POOL_SIZE 16
+#define LOG_MESSAGE_SIZE 160
+#define LOG_RATE_LIMIT 5
+#define LOG_RING_SIZE 1024
 #define MAP_CLEAR 5
 #define MAX_CUBES 500000
-#define PGM_MAX_DIGITS 10
-#define PGM_MAX_DIM 1000
 #define PI 3.14159265358979323846f
-#define UNIT_COUNT (LANDER_COUNT + HUMAN_COUNT)
+#define SCENARIO_STEPS_MAX 256
+#define SOLID_WORDS ((WORLD_XZ + 63) / 64)
+#define SORT_BUCKETS 512
+#define SPAWN_ATTEMPTS 4
+#define TERRAIN_CACHE_VERSION 3
+#define TERRAIN_CHUNK_XZ 10
+#define TERRAIN_EDIT_MS 2
+#define TERRAIN_EDITS_MAX 64
+#define TERRAIN_LISTENERS_MAX 8
+#define TERRAIN_LOD_LEVELS 3
+#define TERRAIN_POLL_MS 1000
+#define TILE_XZ 25
+#define TUNER_ROUNDS 24
+#define TUNER_SETTINGS_MAX 32
+#define WORLD_BRICKS_XZ ((WORLD_XZ + 3) / 4)
+#define WORLD_BRICKS_Y ((WORLD_Y + 3) / 4)
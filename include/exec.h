@@ -6,10 +6,39 @@
 extern "C" {
 #endif
 
-void unit_cycle();
+// Jobs
+int jobs_concurrency();
+void jobs_init(int workers);
+void jobs_node_init(JobNode *node, void (*func)(void *), void *arg);
+void jobs_node_precede(JobNode *before, JobNode *after);
+void jobs_parallel_for(
+    int from, int to, int grain, void (*func)(int, int, void *), void *arg
+);
+void jobs_run(JobNode *nodes, int count);
+void jobs_shutdown();
+
+// Lasers
+int laser_acquire();
+Laser *laser_get(int handle);
+int laser_pool_size();
+void laser_release(int handle);
+
+// Profiling
+int profile_compare_ms(const void *a, const void *b);
+double profile_now();
+void profile_frame(double ms);
+void profile_record(bool on);
+void profile_report();
+void profile_summarize(const char *name, double *ms, int count);
+void profile_tick(double ms);
+
+// Units
+bool unit_cycle();
 void unit_init_all();
 void unit_rm_all();
 void unit_reset_all();
+void unit_shift_all(int dx, int dz);
+void unit_terrain_changed(int x0, int z0, int x1, int z1);
 
 #ifdef __cplusplus
 }
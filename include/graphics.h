@@ -20,23 +20,95 @@
 extern "C" {
 #endif
 
+// Lighting
+const GLubyte *lighting_block(Block *block);
+const float *lighting_sun();
+void lighting_terrain_changed(int x0, int z0, int x1, int z1);
+
 // Materials
 Material *get_material(Colour colour);
 Material *get_material_a(Colour colour, float alpha);
 
+// Bench
+bool bench_run();
+
+// Camera
+void camera_eye(float eye[3]);
+const float *camera_modelview();
+void camera_perspective(float fovy, float aspect, float near, float far);
+const float *camera_projection();
+void camera_update();
+
 // Engine
 void build_display_list();
+void draw_overlay();
 void frustrum_extract();
+const GLfloat (*get_cube_normals())[3];
+const GLfloat (*get_cube_vertices())[3];
+Block *get_display_list();
 void glut_hook_default__display();
+void init_scene();
+void place_camera();
 void shoot_laser();
 void start_game(int *argc, char **argv);
-void tree(float bx, float by, float bz, float tx, float ty, float tz, int l);
+
+// Noise
+void noise_generate(int size, unsigned seed, float roughness);
+
+// Octree
+const OctreeNode **octree_leaves(bool (*test)(const Block *), int *count);
+int octree_levels(int leaf_size);
+void octree_rebuild();
+void octree_terrain_changed(int x0, int z0, int x1, int z1);
+const Voxel *octree_voxels(const OctreeNode *node);
 
 // PGM
 unsigned pgm_calc_ceil();
+const char *pgm_find(const char *filename);
+uint64_t pgm_hash(const char *filename);
 unsigned pgm_get_y_value(double x, double z);
-void pgm_init(const char *filename);
+bool pgm_init(const char *filename);
+bool pgm_is_floating_block(uint8 x, uint8 y, uint8 z);
 void pgm_set_world_terrain();
+void pgm_settle_heights(uint8_t heights[WORLD_XZ][WORLD_XZ]);
+void pgm_stream_close();
+bool pgm_stream_open(const char *filename);
+unsigned pgm_stream_sample(int x, int z);
+
+// Scenario
+bool scenario_apply(double ms);
+double scenario_length();
+bool scenario_load(const char *filename);
+void scenario_rewind();
+
+// Shader
+void glut_hook_shader__display();
+bool shader_init();
+
+// Stream
+bool stream_init(const char *filename);
+void stream_shutdown();
+bool stream_update();
+
+// Terrain
+bool terrain_carve(int x, int y, int z);
+const Voxel *terrain_chunk_voxels(int cx, int cz, int *count);
+void terrain_generate();
+void terrain_listen(void (*listener)(int x0, int z0, int x1, int z1));
+bool terrain_load(const char *filename);
+uint8_t terrain_lod_max(int level, int x, int z);
+uint8_t terrain_lod_min(int level, int x, int z);
+bool terrain_poll();
+bool terrain_reload();
+bool terrain_solid(int x, int y, int z);
+void terrain_set_heights(uint8_t heights[WORLD_XZ][WORLD_XZ]);
+bool terrain_update();
+
+// Tuner
+bool tuner_active();
+void tuner_frame(double ms);
+int tuner_round();
+void tuner_start();
 
 // Hooks
 void glut_hook_default__draw_2d();
@@ -46,14 +118,15 @@ void glut_hook_default__motion(int x, int y);
 void glut_hook_default__mouse(int button, int state, int x, int y);
 void glut_hook_default__passive_motion(int x, int y);
 void glut_hook_default__reshape(int w, int h);
+void glut_hook_default__visibility(int state);
 
 // Map
 void map_laser_layer();
+void map_marker_layer();
 void map_mode_toggle();
-void map_npc_layer();
 void map_outline_layer();
-void map_player_layer();
 void map_pos_update();
+void map_terrain_changed(int x0, int z0, int x1, int z1);
 void map_terrain_layer();
 
 #ifdef __cplusplus
@@ -2,11 +2,18 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "definitions.h"
 
 typedef uint_fast8_t uint8;
+#ifdef WORLD_BRICKS
+typedef uint8 World[WORLD_BRICKS_XZ * WORLD_BRICKS_Y * WORLD_BRICKS_XZ * 64];
+#else
 typedef uint8 World[WORLD_XZ][WORLD_Y][WORLD_XZ];
+#endif
 typedef float Material[4];
+typedef float Matrix[16];
+typedef uint64_t SolidMask[WORLD_XZ][WORLD_Y][SOLID_WORDS];
 
 typedef enum colour {
     COLOUR_NONE = 0,
@@ -30,27 +37,91 @@ typedef enum direction {
     DIRECTION_RIGHT,
 } Direction;
 
+typedef enum log_level {
+    LOG_DEBUG = 0,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+} LogLevel;
+
 typedef enum map_mode {
     MAP_HIDDEN = 0,
     MAP_MINI,
     MAP_FULL,
 } MapMode;
 
+typedef enum renderer {
+    RENDERER_FIXED = 0,
+    RENDERER_SHADER,
+} Renderer;
+
 typedef struct config {
+    bool autotune;
     bool display_all_cubes;
     bool fly_control;
+    bool fog;
     bool full_screen;
     bool overhead_view;
     bool pause_units;
     bool show_fps;
+    bool show_stats;
+    bool stream;
     bool test_world;
     bool timer_unlock;
     bool traction;
+    bool use_cache;
+    bool vsync;
+    bool watch;
     enum map_mode map_mode;
+    enum renderer renderer;
+    int bench_frames;
+    const char *cache_dir;
+    int draw_distance;
+    int fps_cap;
+    int gen_roughness;
+    int gen_seed;
+    int gen_size;
+    int human_count;
+    int job_workers;
+    int lander_count;
+    int lod_far;
+    int lod_near;
+    const char *log_file;
+    const char *map_file;
+    int octree_depth;
+    int octree_leaf;
+    const char *scenario_file;
     int screen_height;
     int screen_width;
+    int stream_budget;
 } Config;
 
+typedef struct profile {
+    double tick_ms;
+    double frame_ms;
+    double window_start;
+    int ticks;
+    int frames;
+} Profile;
+
+typedef struct block {
+    int x;
+    int y;
+    int z;
+    int width;
+    int height;
+    int depth;
+} Block;
+
+typedef struct octree_node {
+    Block bounds;
+    Block cell;
+    int children;
+    int child_count;
+    int voxels;
+    int voxel_count;
+} OctreeNode;
+
 typedef struct position {
     float x;
     float y;
@@ -72,21 +143,67 @@ typedef struct glut_hooks {
     void (*mouse)(int, int, int, int);
     void (*passive_motion)(int, int);
     void (*reshape)(int, int);
+    void (*swap_buffers)();
+    void (*visibility)(int);
 } GlutHooks;
 
+typedef struct job_counter {
+    int pending;
+} JobCounter;
+
+typedef struct job_node {
+    void (*func)(void *);
+    void *arg;
+    int pending;
+    int successor_count;
+    struct job_node *successors[JOBS_MAX_SUCCESSORS];
+    JobCounter *counter;
+} JobNode;
+
+typedef struct log_site {
+    const char *file;
+    int line;
+    long window;
+    int count;
+    int suppressed;
+} LogSite;
+
 typedef struct lasers {
     bool active;
     Position from;
     Position to;
 } Laser;
 
+typedef struct laser_pool {
+    Laser *lasers;
+    int *free;
+    int capacity;
+    int free_count;
+} LaserPool;
+
 typedef struct pgm {
     int x;
     int y;
     int z;
-    unsigned long data[PGM_MAX_DIM * PGM_MAX_DIM];
+    uint16_t *data;
 } Pgm;
 
+typedef struct voxel {
+    uint16_t x;
+    uint16_t y;
+    uint16_t z;
+} Voxel;
+
+typedef struct surface {
+    uint8_t (*heights)[WORLD_XZ];
+    Voxel *voxels;
+    int count;
+    uint8_t y_max;
+    int epoch;
+    void *mapping;
+    size_t length;
+} Surface;
+
 typedef struct view {
     int cam_x;
     int cam_y;
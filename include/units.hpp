@@ -21,7 +21,9 @@ class Unit {
     Coordinate target;
     Coordinate origin;
     static std::vector<Unit *> units;
+    static Unit *occupants[WORLD_XZ][WORLD_Y][WORLD_XZ];
     static uint8 cycle;
+    static long next_id;
     const std::string as_str;
 
     public:
@@ -33,14 +35,20 @@ class Unit {
     static uint8 calc_min_y(int x, int z);
     static coordinate calc_random_coordinate(
         bool edge = false,
-        bool above_terrain = true
+        bool above_terrain = true,
+        bool claim = false
     );
     int y_distance(const Unit *target);
 
     public:
     static Unit *find_unit(Coordinate coordinate);
+    static void index_free_cells();
+    static void index_free_cells(int x0, int z0, int x1, int z1);
     virtual void ai();
     virtual void render();
+    virtual void settle();
+    virtual void think();
+    bool shift(int dx, int dz);
     void shoot();
     bool is_occupying(Coordinate &pos);
 };
@@ -71,6 +79,7 @@ class Human : public Unit {
     public:
     void ai() override;
     void render() override;
+    void settle() override;
     void action_lift();
     void action_drop();
     void action_capture();
@@ -91,6 +100,8 @@ class Lander : public Unit {
 
     private:
     State state = SEARCHING;
+    int laser = -1;
+    Coordinate sighted = {-1, -1, -1};
 
     public:
     Human *captive = nullptr;
@@ -123,9 +134,11 @@ class Lander : public Unit {
     bool can_capture();
     bool can_pursue(Human **human);
     bool can_shoot_player();
+    bool find_human(Coordinate *cell);
 
     public:
     void abandon_captive(bool drop=false);
     void ai() override;
     void render() override;
+    void think() override;
 };
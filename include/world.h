@@ -0,0 +1,25 @@
+#pragma once
+
+#include "types.h"
+
+// Voxel grids are laid out [x][y][z] unless built with WORLD_BRICKS, which
+// stores them as 4x4x4 bricks, a cache line each, with the voxels inside a
+// brick in Morton order so near neighbours along any axis share a line.
+// Everything reads and writes them through world_at().
+
+#ifdef WORLD_BRICKS
+
+static inline int world_index(int x, int y, int z) {
+    int brick = ((x >> 2) * WORLD_BRICKS_Y + (y >> 2)) * WORLD_BRICKS_XZ
+        + (z >> 2);
+    return brick << 6 | (x & 1) | (y & 1) << 1 | (z & 1) << 2
+        | (x & 2) << 2 | (y & 2) << 3 | (z & 2) << 4;
+}
+
+#define world_at(world, x, y, z) ((world)[world_index((x), (y), (z))])
+
+#else
+
+#define world_at(world, x, y, z) ((world)[x][y][z])
+
+#endif
@@ -8,59 +8,124 @@
 #include <cstring>
 #include "debug.h"
 #include "exec.h"
+#include "graphics.h"
 #include "units.hpp"
 
 using namespace std;
 
-extern Laser lasers[];
+extern Config config;
+extern Laser player_laser;
 extern Position player_pos;
+extern "C" Surface surface;
 extern View view;
 extern World world_units;
 
 static void _render() {
-    memset(world_units, 0, WORLD_XZ * WORLD_XZ * WORLD_Y);
+    memset(world_units, 0, sizeof(World));
+    memset(Unit::occupants, 0, sizeof(Unit::occupants));
     for (long i = Unit::units.size(); i > 0; i--) {
         Unit::units[i - 1]->render();
     }
 }
 
-static void _damage() {
-    if (lasers[0].active) {
-        float rot_x = (view.cam_x / 180.0f * PI);
-        float rot_y = (view.cam_y / 180.0f * PI);
-        for (int i = 0; i < WORLD_XZ * WORLD_XZ; i++) {
-            Position pt = {
-                (player_pos.x - sinf(rot_y) * i) * -1,
-                (player_pos.y + sinf(rot_x) * i) * -1,
-                (player_pos.z + cosf(rot_y) * i) * -1
-            };
-            for (long j = Unit::units.size(); j > 0; j--) {
-                Unit *unit = Unit::units[j - 1];
-                if (fabs(unit->origin.x - pt.x) <= 2 &&
-                    fabs(unit->origin.y - pt.y) <= 2 &&
-                    fabs(unit->origin.z - pt.z) <= 2)
-                    unit->shoot();
+struct Ray {
+    Position points[WORLD_XZ * WORLD_XZ];
+    int length;
+    vector<char> hits;
+};
+
+static void _find_hits(int from, int to, void *arg) {
+    Ray *ray = static_cast<Ray *>(arg);
+    for (int j = from; j < to; j++) {
+        Unit *unit = Unit::units[j];
+        for (int i = 0; i < ray->length; i++) {
+            const Position &pt = ray->points[i];
+            if (fabs(unit->origin.x - pt.x) <= 2 &&
+                fabs(unit->origin.y - pt.y) <= 2 &&
+                fabs(unit->origin.z - pt.z) <= 2) {
+                ray->hits[j] = true;
+                break;
             }
         }
     }
 }
 
+static void _damage() {
+    static Ray ray;
+    static bool was_active = false;
+    // a shot stays active for a while, but only carves as it is fired
+    bool fired = player_laser.active && !was_active;
+    was_active = player_laser.active;
+    if (!player_laser.active) return;
+    float rot_x = (view.cam_x / 180.0f * PI);
+    float rot_y = (view.cam_y / 180.0f * PI);
+    ray.length = 0;
+    for (int i = 0; i < WORLD_XZ * WORLD_XZ; i++) {
+        ray.points[i] = {
+            (player_pos.x - sinf(rot_y) * i) * -1,
+            (player_pos.y + sinf(rot_x) * i) * -1,
+            (player_pos.z + cosf(rot_y) * i) * -1
+        };
+        ray.length = i + 1;
+        // the beam stops at, and carves, the first terrain it reaches; columns
+        // are hollow shells, so anything under a surface cube counts as it
+        int x = (int) floorf(ray.points[i].x);
+        int y = (int) floorf(ray.points[i].y);
+        int z = (int) floorf(ray.points[i].z);
+        if (x < 0 || y < 0 || z < 0) continue;
+        if (x >= WORLD_XZ || y >= WORLD_Y || z >= WORLD_XZ) continue;
+        if (y > surface.heights[x][z]) continue;
+        if (fired) terrain_carve(x, surface.heights[x][z], z);
+        break;
+    }
+    // test units concurrently, then apply hits in reverse as deletes reorder
+    long count = Unit::units.size();
+    ray.hits.assign(count, false);
+    jobs_parallel_for(0, (int) count, 2, _find_hits, &ray);
+    for (long j = count; j > 0; j--) {
+        if (ray.hits[j - 1]) Unit::units[j - 1]->shoot();
+    }
+}
+
+static void _think(int from, int to, void *arg) {
+    (void) arg;
+    for (int i = from; i < to; i++) Unit::units[i]->think();
+}
+
 static void _react() {
+    // look concurrently, then act serially as actions move and delete units
+    jobs_parallel_for(0, (int) Unit::units.size(), 4, _think, nullptr);
     for (long i = Unit::units.size(); i > 0; i--) {
         Unit::units[i - 1]->ai();
     }
 }
 
-void unit_cycle() {
+bool unit_cycle() {
+    static World rendered;
+    static vector<Laser> fired;
     ++Unit::cycle;
     _render();
     _damage();
     _react();
+    // report whether anything visible changed since the previous cycle
+    size_t laser_count = laser_pool_size();
+    bool changed = memcmp(rendered, world_units, sizeof(World)) ||
+        fired.size() != laser_count ||
+        (laser_count &&
+         memcmp(fired.data(), laser_get(0), sizeof(Laser) * laser_count));
+    if (changed) {
+        memcpy(rendered, world_units, sizeof(World));
+        fired.clear();
+        for (size_t i = 0; i < laser_count; i++)
+            fired.push_back(*laser_get((int) i));
+    }
+    return changed;
 }
 
 void unit_init_all(){
-    for (int i = 0; i < HUMAN_COUNT; i++) new Human();
-    for (int i = 0; i < LANDER_COUNT; i++) new Lander();
+    Unit::index_free_cells();
+    for (int i = 0; i < config.human_count; i++) new Human();
+    for (int i = 0; i < config.lander_count; i++) new Lander();
 }
 
 void unit_rm_all() {
@@ -73,3 +138,35 @@ void unit_reset_all(){
     unit_rm_all();
     unit_init_all();
 }
+
+void unit_terrain_changed(int x0, int z0, int x1, int z1) {
+    // keep units where they are, only lifting or re-seating those the change
+    // reached, then refresh the spawn index for the new ground
+    bool moved = false;
+    for (Unit *unit : Unit::units) {
+        if (unit->origin.x < x0 - 2 || unit->origin.x >= x1 + 2) continue;
+        if (unit->origin.z < z0 - 2 || unit->origin.z >= z1 + 2) continue;
+        int y = unit->origin.y;
+        unit->settle();
+        if (unit->origin.y != y) moved = true;
+    }
+    if (moved) _render();
+    Unit::index_free_cells(x0, z0, x1, z1);
+}
+
+void unit_shift_all(int dx, int dz) {
+    // units left behind by the window are replaced to keep the counts steady
+    int humans = 0;
+    int landers = 0;
+    for (long i = Unit::units.size(); i > 0; i--) {
+        Unit *unit = Unit::units[i - 1];
+        if (unit->shift(dx, dz)) continue;
+        if (dynamic_cast<Human *>(unit)) humans++;
+        else landers++;
+        delete unit;
+    }
+    _render();
+    Unit::index_free_cells();
+    for (int i = 0; i < humans; i++) new Human();
+    for (int i = 0; i < landers; i++) new Lander();
+}
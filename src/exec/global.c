@@ -7,29 +7,64 @@
 #include "graphics.h"
 
 Config config = {
+    .autotune = false,
     .display_all_cubes = false,
     .fly_control = false,
+    .fog = false,
     .full_screen = false,
     .overhead_view=false,
     .pause_units=false,
     .show_fps = false,
+    .show_stats = false,
+    .stream = false,
     .test_world = false,
     .timer_unlock=false,
     .traction=false,
+    .use_cache = true,
+    .vsync = false,
+    .watch = false,
     .map_mode = MAP_MINI,
+    .renderer = RENDERER_FIXED,
+    .bench_frames = 0,
+    .cache_dir = NULL,
+    .draw_distance = DRAW_DISTANCE,
+    .fps_cap = 60,
+    .gen_roughness = GEN_ROUGHNESS,
+    .gen_seed = 1,
+    .gen_size = 0,
+    .human_count = HUMAN_COUNT,
+    .job_workers = -1,
+    .lander_count = LANDER_COUNT,
+    .lod_far = LOD_FAR_RADIUS,
+    .lod_near = LOD_NEAR_RADIUS,
+    .log_file = NULL,
+    .map_file = "ground.pgm",
+    .octree_depth = OCTREE_DEPTH,
+    .octree_leaf = OCTREE_LEAF,
+    .scenario_file = NULL,
     .screen_height = 720,
     .screen_width = 1280,
+    .stream_budget = STREAM_BUDGET_MB,
 };
 
-Laser lasers[UNIT_COUNT + 1] = {{0}};
+Laser player_laser = {0};
+
+LaserPool laser_pool = {
+    .lasers = NULL,
+    .free = NULL,
+    .capacity = 0,
+    .free_count = 0
+};
 
 Pgm terrain = {
     .x = 0,
     .y = 0,
     .z = 0,
-    .data = {0}
+    .data = NULL
 };
 
+Profile profile = {0};
+
 Position player_pos = {
     .x = -1.0f * WORLD_XZ / 2.0f,
     .y = -1.0f * WORLD_Y + MAP_CLEAR,
@@ -44,7 +79,19 @@ GlutHooks glut_hooks = {
     .motion = glut_hook_default__motion,
     .mouse = glut_hook_default__mouse,
     .passive_motion = glut_hook_default__passive_motion,
-    .reshape = glut_hook_default__reshape
+    .reshape = glut_hook_default__reshape,
+    .swap_buffers = glutSwapBuffers,
+    .visibility = glut_hook_default__visibility
+};
+
+Surface surface = {
+    .heights = NULL,
+    .voxels = NULL,
+    .count = 0,
+    .y_max = 0,
+    .epoch = 0,
+    .mapping = NULL,
+    .length = 0
 };
 
 View view = {
@@ -55,5 +102,6 @@ View view = {
     .count = 0
 };
 
-World world_terrain = {{{COLOUR_NONE}}};
-World world_units = {{{COLOUR_NONE}}};
+SolidMask world_solid = {{{0}}};
+World world_terrain;
+World world_units;
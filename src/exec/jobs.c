@@ -0,0 +1,232 @@
+/**
+ * jobs.c
+ *
+ * Work-stealing thread pool shared by the terrain pipeline, visibility, AI and
+ * the minimap. Every thread (the caller being thread 0) owns a deque: owners
+ * push and pop from the bottom while idle threads steal from the top of
+ * somebody else's. Waiting threads help out rather than block so jobs can
+ * safely submit more jobs.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include "debug.h"
+#include "exec.h"
+
+#define _SPINS_BEFORE_SLEEP 64
+#define _MAX_CHUNKS 256
+
+typedef struct deque {
+    pthread_mutex_t lock;
+    JobNode *items[JOBS_QUEUE_SIZE];
+    unsigned top;
+    unsigned bottom;
+} Deque;
+
+typedef struct range {
+    void (*func)(int, int, void *);
+    void *arg;
+    int from;
+    int to;
+} Range;
+
+static Deque deques[JOBS_MAX_WORKERS + 1];
+static pthread_t threads[JOBS_MAX_WORKERS];
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static int queued = 0;
+static int sleepers = 0;
+static int worker_count = 0;
+static bool running = false;
+static __thread int thread_index = 0;
+
+static bool _push(Deque *deque, JobNode *node) {
+    pthread_mutex_lock(&deque->lock);
+    bool pushed = deque->bottom - deque->top < JOBS_QUEUE_SIZE;
+    if (pushed) {
+        deque->items[deque->bottom++ % JOBS_QUEUE_SIZE] = node;
+        __atomic_add_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return pushed;
+}
+
+static JobNode *_pop(Deque *deque) {
+    JobNode *node = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        node = deque->items[--deque->bottom % JOBS_QUEUE_SIZE];
+        __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return node;
+}
+
+static JobNode *_steal(Deque *deque) {
+    JobNode *node = NULL;
+    if (pthread_mutex_trylock(&deque->lock)) return NULL;
+    if (deque->bottom != deque->top) {
+        node = deque->items[deque->top++ % JOBS_QUEUE_SIZE];
+        __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return node;
+}
+
+static JobNode *_find_work() {
+    JobNode *node = _pop(&deques[thread_index]);
+    for (int i = 1; !node && i <= worker_count; i++) {
+        node = _steal(&deques[(thread_index + i) % (worker_count + 1)]);
+    }
+    return node;
+}
+
+static void _execute(JobNode *node);
+
+static void _schedule(JobNode *node) {
+    if (!_push(&deques[thread_index], node)) {
+        _execute(node);  // queue is saturated, run it in place instead
+        return;
+    }
+    if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&idle_lock);
+        pthread_cond_signal(&idle_cond);
+        pthread_mutex_unlock(&idle_lock);
+    }
+}
+
+static void _execute(JobNode *node) {
+    node->func(node->arg);
+    for (int i = 0; i < node->successor_count; i++) {
+        JobNode *next = node->successors[i];
+        if (!__atomic_sub_fetch(&next->pending, 1, __ATOMIC_ACQ_REL))
+            _schedule(next);
+    }
+    if (node->counter)
+        __atomic_sub_fetch(&node->counter->pending, 1, __ATOMIC_ACQ_REL);
+}
+
+static void *_worker(void *arg) {
+    thread_index = (int) (long) arg;
+    int spins = 0;
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        JobNode *node = _find_work();
+        if (node) {
+            _execute(node);
+            spins = 0;
+        } else if (++spins < _SPINS_BEFORE_SLEEP) {
+            sched_yield();
+        } else {
+            pthread_mutex_lock(&idle_lock);
+            __atomic_add_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+            if (running && !__atomic_load_n(&queued, __ATOMIC_SEQ_CST))
+                pthread_cond_wait(&idle_cond, &idle_lock);
+            __atomic_sub_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&idle_lock);
+            spins = 0;
+        }
+    }
+    return NULL;
+}
+
+static void _wait(JobCounter *counter) {
+    while (__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE)) {
+        JobNode *node = _find_work();
+        if (node) _execute(node);
+        else sched_yield();
+    }
+}
+
+static void _run_range(void *arg) {
+    Range *range = arg;
+    range->func(range->from, range->to, range->arg);
+}
+
+int jobs_concurrency() {
+    return worker_count + 1;
+}
+
+void jobs_init(int workers) {
+    assert_not(running, "job system already initialized");
+    if (workers < 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 1 ? (int) cores - 1 : 0;
+    }
+    worker_count = workers < JOBS_MAX_WORKERS ? workers : JOBS_MAX_WORKERS;
+    for (int i = 0; i <= worker_count; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        deques[i].top = deques[i].bottom = 0;
+    }
+    running = true;
+    for (int i = 0; i < worker_count; i++) {
+        int status = pthread_create(
+            &threads[i], NULL, _worker, (void *) (long) (i + 1)
+        );
+        if (status) {
+            log("could not start job worker, continuing with %d", i);
+            worker_count = i;
+            break;
+        }
+    }
+    log("job system started with %d worker(s)", worker_count);
+}
+
+void jobs_node_init(JobNode *node, void (*func)(void *), void *arg) {
+    memset(node, 0, sizeof(JobNode));
+    node->func = func;
+    node->arg = arg;
+}
+
+void jobs_node_precede(JobNode *before, JobNode *after) {
+    assert_lt(
+        before->successor_count, JOBS_MAX_SUCCESSORS, "too many successors"
+    );
+    before->successors[before->successor_count++] = after;
+    after->pending++;
+}
+
+void jobs_parallel_for(
+    int from, int to, int grain, void (*func)(int, int, void *), void *arg
+) {
+    int length = to - from;
+    if (length <= 0) return;
+    if (grain < 1) grain = 1;
+    if (!worker_count || length <= grain) {
+        func(from, to, arg);
+        return;
+    }
+    int chunk = (length + _MAX_CHUNKS - 1) / _MAX_CHUNKS;
+    if (chunk < grain) chunk = grain;
+    int count = (length + chunk - 1) / chunk;
+    Range ranges[_MAX_CHUNKS];
+    JobNode nodes[_MAX_CHUNKS];
+    for (int i = 0; i < count; i++) {
+        ranges[i].func = func;
+        ranges[i].arg = arg;
+        ranges[i].from = from + i * chunk;
+        ranges[i].to = ranges[i].from + chunk < to ? ranges[i].from + chunk : to;
+        jobs_node_init(&nodes[i], _run_range, &ranges[i]);
+    }
+    jobs_run(nodes, count);
+}
+
+void jobs_run(JobNode *nodes, int count) {
+    JobCounter counter = {count};
+    for (int i = 0; i < count; i++) nodes[i].counter = &counter;
+    for (int i = 0; i < count; i++) {
+        if (!nodes[i].pending) _schedule(&nodes[i]);
+    }
+    _wait(&counter);
+}
+
+void jobs_shutdown() {
+    if (!running) return;
+    pthread_mutex_lock(&idle_lock);
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_lock);
+    for (int i = 0; i < worker_count; i++) pthread_join(threads[i], NULL);
+    worker_count = 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * lasers.c
+ *
+ * Pool of enemy laser beams. Firing units acquire a handle once and release it
+ * when they are destroyed; handles are recycled through a free list so the pool
+ * only grows to the peak number of simultaneous owners.
+ */
+
+#include <string.h>
+#include "debug.h"
+#include "exec.h"
+
+extern LaserPool laser_pool;
+
+int laser_acquire() {
+    LaserPool *pool = &laser_pool;
+    if (!pool->free_count) {
+        int capacity = pool->capacity ? pool->capacity * 2 : LASER_POOL_SIZE;
+        Laser *lasers = realloc(pool->lasers, capacity * sizeof(Laser));
+        int *free_list = realloc(pool->free, capacity * sizeof(int));
+        assert_ok(lasers && free_list, "could not grow laser pool");
+        memset(lasers + pool->capacity, 0,
+            (capacity - pool->capacity) * sizeof(Laser));
+        // hand out lower handles first
+        for (int i = capacity - 1; i >= pool->capacity; i--)
+            free_list[pool->free_count++] = i;
+        pool->lasers = lasers;
+        pool->free = free_list;
+        pool->capacity = capacity;
+    }
+    int handle = pool->free[--pool->free_count];
+    pool->lasers[handle].active = false;
+    return handle;
+}
+
+Laser *laser_get(int handle) {
+    assert_gte(handle, 0, "invalid laser handle");
+    assert_lt(handle, laser_pool.capacity, "invalid laser handle");
+    return &laser_pool.lasers[handle];
+}
+
+int laser_pool_size() {
+    return laser_pool.capacity;
+}
+
+void laser_release(int handle) {
+    if (handle < 0) return;
+    laser_get(handle)->active = false;
+    laser_pool.free[laser_pool.free_count++] = handle;
+}
@@ -0,0 +1,175 @@
+/**
+ * logger.c
+ *
+ * Asynchronous logger. Producers format into a fixed-size lock-free ring and
+ * return immediately; a background thread drains the ring to stderr or a file
+ * so console I/O never stalls a game tick. Each call site is rate-limited to
+ * LOG_RATE_LIMIT messages per second, with the remainder counted and reported.
+ * Failed asserts flush the ring before aborting, so the lead-up is kept.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "debug.h"
+
+typedef struct slot {
+    size_t sequence;
+    LogLevel level;
+    const char *file;
+    int line;
+    const char *func;
+    double time;
+    int suppressed;
+    char text[LOG_MESSAGE_SIZE];
+} Slot;
+
+static Slot ring[LOG_RING_SIZE];
+static size_t head = 0;
+static size_t tail = 0;
+static int dropped = 0;
+static bool running = false;
+static FILE *output = NULL;
+static pthread_t drain_thread;
+static struct timespec epoch;
+static const char *level_names[] = {"debug", "info", "warn", "error"};
+
+static double _now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - epoch.tv_sec) + (now.tv_nsec - epoch.tv_nsec) / 1e9;
+}
+
+static const char *_basename(const char *path) {
+    const char *name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+static void _print(Slot *slot) {
+    fprintf(
+        output ? output : stderr,
+        "%9.3f %-5s %s:%d %s(): %s",
+        slot->time,
+        level_names[slot->level],
+        _basename(slot->file),
+        slot->line,
+        slot->func,
+        slot->text
+    );
+    FILE *stream = output ? output : stderr;
+    if (slot->suppressed) fprintf(stream, " (+%d suppressed)", slot->suppressed);
+    fputc('\n', stream);
+}
+
+static bool _drain() {
+    bool drained = false;
+    for (;;) {
+        Slot *slot = &ring[head % LOG_RING_SIZE];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != head + 1)
+            break;
+        _print(slot);
+        __atomic_store_n(
+            &slot->sequence, head + LOG_RING_SIZE, __ATOMIC_RELEASE
+        );
+        head++;
+        drained = true;
+    }
+    int lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_ACQ_REL);
+    if (lost) {
+        fprintf(output ? output : stderr, "%9.3f warn  ring full, "
+            "%d message(s) dropped\n", _now(), lost);
+    }
+    if (drained || lost) fflush(output ? output : stderr);
+    return drained;
+}
+
+static void *_drain_loop(void *arg) {
+    struct timespec pause = {0, 5 * 1000 * 1000};
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        if (!_drain()) nanosleep(&pause, NULL);
+    }
+    _drain();
+    return NULL;
+}
+
+void logger_init(const char *filename) {
+    clock_gettime(CLOCK_MONOTONIC, &epoch);
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) ring[i].sequence = i;
+    if (filename) {
+        output = fopen(filename, "a");
+        assert_ok(output, "could not open log file");
+    }
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    if (pthread_create(&drain_thread, NULL, _drain_loop, NULL))
+        __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+}
+
+void logger_flush() {
+    // stop the drain thread, which empties the ring on its way out; any
+    // later messages write straight through
+    if (!__atomic_exchange_n(&running, false, __ATOMIC_ACQ_REL)) return;
+    if (!pthread_equal(pthread_self(), drain_thread))
+        pthread_join(drain_thread, NULL);
+}
+
+void logger_shutdown() {
+    logger_flush();
+    if (output) fclose(output);
+    output = NULL;
+}
+
+void logger_write(
+    LogSite *site, LogLevel level, const char *func, const char *format, ...
+) {
+    double time = _now();
+    // rate limit per call site
+    long window = (long) time;
+    if (__atomic_load_n(&site->window, __ATOMIC_RELAXED) != window) {
+        __atomic_store_n(&site->window, window, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+    }
+    int count = __atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED);
+    if (count > LOG_RATE_LIMIT) {
+        __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    // claim a slot, dropping the message rather than waiting when full
+    Slot local;
+    Slot *slot = &local;
+    bool claimed = false;
+    size_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    while (!claimed && __atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        Slot *next = &ring[position % LOG_RING_SIZE];
+        size_t sequence = __atomic_load_n(&next->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == position) {
+            claimed = __atomic_compare_exchange_n(
+                &tail, &position, position + 1, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED
+            );
+            if (claimed) slot = next;
+        } else if (sequence < position) {
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        }
+    }
+    slot->level = level;
+    slot->file = site->file;
+    slot->line = site->line;
+    slot->func = func;
+    slot->time = time;
+    slot->suppressed = __atomic_exchange_n(
+        &site->suppressed, 0, __ATOMIC_RELAXED
+    );
+    va_list args;
+    va_start(args, format);
+    vsnprintf(slot->text, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+    if (!claimed) {
+        _print(slot);  // not started or already stopped, write through
+        return;
+    }
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+}
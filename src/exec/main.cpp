@@ -10,28 +10,115 @@ int main(int argc, char **argv) {
     // Parse CLI arguments
     for (int i = 1; i < argc; i++) {
         char *arg = argv[i];
-        if (!strcmp(arg, "-drawall")) {
+        if (!strcmp(arg, "-bench") && i + 1 < argc) {
+            config.bench_frames = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-drawall")) {
             config.display_all_cubes = !config.display_all_cubes;
+        } else if (!strcmp(arg, "-draw") && i + 1 < argc) {
+            config.draw_distance = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-fog")) {
+            config.fog = !config.fog;
         } else if (!strcmp(arg, "-fps")) {
             config.show_fps = !config.show_fps;
         } else if (!strcmp(arg, "-full")) {
             config.full_screen = !config.full_screen;
+        } else if (!strcmp(arg, "-fpscap") && i + 1 < argc) {
+            config.fps_cap = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-renderer") && i + 1 < argc) {
+            config.renderer = strcmp(argv[++i], "shader")
+                ? RENDERER_FIXED
+                : RENDERER_SHADER;
+        } else if (!strcmp(arg, "-vsync")) {
+            config.vsync = !config.vsync;
+        } else if (!strcmp(arg, "-generate") && i + 1 < argc) {
+            config.gen_size = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-seed") && i + 1 < argc) {
+            config.gen_seed = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-roughness") && i + 1 < argc) {
+            config.gen_roughness = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-humans") && i + 1 < argc) {
+            config.human_count = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-landers") && i + 1 < argc) {
+            config.lander_count = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-lod") && i + 2 < argc) {
+            config.lod_near = atoi(argv[++i]);
+            config.lod_far = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-octree") && i + 2 < argc) {
+            config.octree_leaf = atoi(argv[++i]);
+            config.octree_depth = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-autotune")) {
+            config.autotune = !config.autotune;
+        } else if (!strcmp(arg, "-watch")) {
+            config.watch = !config.watch;
+        } else if (!strcmp(arg, "-map") && i + 1 < argc) {
+            config.map_file = argv[++i];
+        } else if (!strcmp(arg, "-scenario") && i + 1 < argc) {
+            config.scenario_file = argv[++i];
+        } else if (!strcmp(arg, "-stream")) {
+            config.stream = !config.stream;
+        } else if (!strcmp(arg, "-streammem") && i + 1 < argc) {
+            config.stream_budget = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-stats")) {
+            config.show_stats = !config.show_stats;
+        } else if (!strcmp(arg, "-stress")) {
+            config.lander_count = STRESS_LANDER_COUNT;
+            config.show_stats = true;
+        } else if (!strcmp(arg, "-log") && i + 1 < argc) {
+            config.log_file = argv[++i];
+        } else if (!strcmp(arg, "-jobs") && i + 1 < argc) {
+            config.job_workers = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-nocache")) {
+            config.use_cache = !config.use_cache;
+        } else if (!strcmp(arg, "-cache") && i + 1 < argc) {
+            config.cache_dir = argv[++i];
         } else if (!strcmp(arg, "-testworld")) {
             config.test_world = !config.test_world;
         } else {
-            puts("usage: a1 [-drawall] [-testworld] [-fps] [-full]");
+            puts(
+                "usage: a1 [-drawall] [-testworld] [-fps] [-full] [-jobs n] "
+                "[-log file] [-fpscap n] [-vsync] [-humans n] [-landers n] "
+                "[-stats] [-stress] [-nocache] [-cache dir] [-draw n] "
+                "[-lod near far] [-fog] [-map file] [-stream] "
+                "[-streammem mb] [-generate size] [-seed n] "
+                "[-roughness pct] [-watch] [-renderer fixed|shader] "
+                "[-bench frames] [-scenario file] [-octree leaf depth] "
+                "[-autotune]"
+            );
             exit(1);
         }
     }
 
     // Initialize game
+    logger_init(config.log_file);
+    atexit(logger_shutdown);
+    jobs_init(config.job_workers);
+    atexit(jobs_shutdown);
+
     log("loading map");
-    pgm_init("ground.pgm");
-    pgm_set_world_terrain();
+    if (config.gen_size > 0) {
+        terrain_generate();
+    } else if (config.stream && stream_init(config.map_file)) {
+        atexit(stream_shutdown);
+    } else if (!terrain_load(config.map_file)) {
+        exit(1);
+    }
 
-    log("adding units");
+    terrain_listen(unit_terrain_changed);
+    log_info(
+        "adding %d humans and %d landers",
+        config.human_count,
+        config.lander_count
+    );
     unit_init_all();
 
+    if (config.scenario_file && !scenario_load(config.scenario_file))
+        exit(1);
+    if (config.bench_frames > 0) {
+        bool ran = bench_run();
+        unit_rm_all();
+        return ran ? 0 : 1;
+    }
+
     log("starting game");
     start_game(&argc, argv);
     return 0;
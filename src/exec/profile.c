@@ -0,0 +1,90 @@
+/**
+ * profile.c
+ *
+ * Rolling tick and frame timings, reported once a second when enabled with
+ * -stats or -stress. Frames can also be recorded individually, e.g. over a
+ * scenario, and summarized once recording stops.
+ */
+
+#include <time.h>
+#include "debug.h"
+#include "exec.h"
+
+extern Config config;
+extern Profile profile;
+
+static double *recorded = NULL;
+static int recorded_count = 0;
+static int recorded_capacity = 0;
+static bool recording = false;
+
+int profile_compare_ms(const void *a, const void *b) {
+    // qsort order for timings
+    double l = *(const double *) a;
+    double r = *(const double *) b;
+    return (l > r) - (l < r);
+}
+
+double profile_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+void profile_frame(double ms) {
+    profile.frame_ms += ms;
+    profile.frames++;
+    if (!recording) return;
+    if (recorded_count == recorded_capacity) {
+        recorded_capacity = recorded_capacity ? recorded_capacity * 2 : 1024;
+        recorded = realloc(recorded, recorded_capacity * sizeof(double));
+        assert_ok(recorded, "could not grow frame recording");
+    }
+    recorded[recorded_count] = ms;
+    printf("%d,%.3f\n", recorded_count++, ms);
+}
+
+void profile_record(bool on) {
+    if (on && !recording) {
+        recorded_count = 0;
+        printf("frame,cpu_ms\n");
+    } else if (!on && recording) {
+        profile_summarize("frames", recorded, recorded_count);
+        free(recorded);
+        recorded = NULL;
+        recorded_count = recorded_capacity = 0;
+    }
+    recording = on;
+}
+
+void profile_report() {
+    double now = profile_now();
+    if (now - profile.window_start < 1000) return;
+    if (config.show_stats) {
+        log_info(
+            "%d ticks, %.3f ms/tick; %d frames, %.3f ms/frame",
+            profile.ticks,
+            profile.ticks ? profile.tick_ms / profile.ticks : 0,
+            profile.frames,
+            profile.frames ? profile.frame_ms / profile.frames : 0
+        );
+    }
+    profile = (Profile) {0, 0, now, 0, 0};
+}
+
+void profile_summarize(const char *name, double *ms, int count) {
+    if (count <= 0) return;
+    double total = 0;
+    for (int i = 0; i < count; i++) total += ms[i];
+    qsort(ms, count, sizeof(double), profile_compare_ms);
+    log_info(
+        "%s: mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms",
+        name, total / count, ms[count / 2], ms[count * 95 / 100],
+        ms[count - 1]
+    );
+}
+
+void profile_tick(double ms) {
+    profile.tick_ms += ms;
+    profile.ticks++;
+}
@@ -0,0 +1,298 @@
+/**
+ * bench.c
+ *
+ * Headless rendering benchmark. Makes a surfaceless EGL context with an
+ * offscreen framebuffer, so it runs on Mesa's software rasterizers without a
+ * display or GPU, then flies the display hook around a fixed orbit of the
+ * world, or through a scenario when one is given. Each frame reports the CPU
+ * time spent issuing it and the time glFinish then waits for the GL to catch
+ * up.
+ *
+ * After the frames, the world queries are timed on their own: culling over
+ * the same views, settling columns onto the terrain, and unit sized collision
+ * probes. On Linux each also reports the cache misses the hardware counted on
+ * the main thread only, so the voxel layouts (see world.h) can be compared;
+ * culling spreads over the job workers, whose misses go uncounted.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+#include "world.h"
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern Config config;
+extern GlutHooks glut_hooks;
+extern Position player_pos;
+extern Surface surface;
+extern View view;
+extern World world_terrain;
+extern World world_units;
+
+// keeps the query results live so they aren't optimized away
+static volatile int found = 0;
+
+static void _swap_nothing() {}
+
+static void _place_on_orbit(int frame) {
+    // circle the world centre, facing inwards and looking slightly down
+    float angle = 2 * PI * frame / config.bench_frames;
+    float radius = WORLD_XZ / 4.0f;
+    int y = surface.y_max + MAP_CLEAR;
+    player_pos.x = -(WORLD_XZ / 2.0f - radius * sinf(angle));
+    player_pos.y = -(float) (y < WORLD_Y - 1 ? y : WORLD_Y - 1);
+    player_pos.z = -(WORLD_XZ / 2.0f + radius * cosf(angle));
+    view.cam_x = BENCH_PITCH;
+    view.cam_y = (int) (angle * 180.0f / PI);
+}
+
+static void _place_on_scenario(int frame) {
+    // spread the frames evenly over the scenario's length
+    int last = config.bench_frames - 1;
+    scenario_apply(last ? scenario_length() * frame / last : 0);
+}
+
+static void _place(int frame) {
+    if (config.scenario_file) _place_on_scenario(frame);
+    else _place_on_orbit(frame);
+}
+
+static void _rewind() {
+    // start from the scenario's own toggles, not wherever the last pass left
+    if (config.scenario_file) scenario_rewind();
+}
+
+static void _cull(int frame) {
+    // the frustum and sort eye come from the camera, not the player directly
+    _place(frame);
+    camera_update();
+    build_display_list();
+}
+
+static void _settle(int frame) {
+    // drop down every column to the first terrain voxel, as units settle
+    (void) frame;
+    int total = 0;
+    for (int x = 0; x < WORLD_XZ; x++) {
+        for (int z = 0; z < WORLD_XZ; z++) {
+            int y = WORLD_Y - 1;
+            while (y > 0 && !world_at(world_terrain, x, y, z)) y--;
+            total += y;
+        }
+    }
+    found += total;
+}
+
+static void _collide(int frame) {
+    // a unit's neighbourhood around pseudo-random points on the surface
+    uint32_t state = 2654435761u * (uint32_t) (frame + 1);
+    int hits = 0;
+    for (int i = 0; i < BENCH_PROBES; i++) {
+        state = state * 1664525u + 1013904223u;
+        int x = 1 + (int) (state >> 8) % (WORLD_XZ - 2);
+        int z = 1 + (int) (state >> 20) % (WORLD_XZ - 2);
+        int y = surface.heights[x][z];
+        if (y < 1) y = 1;
+        if (y > WORLD_Y - 2) y = WORLD_Y - 2;
+        for (int dx = -1; dx <= 1; dx++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dz = -1; dz <= 1; dz++)
+                    hits += world_at(world_terrain, x + dx, y + dy, z + dz)
+                        || world_at(world_units, x + dx, y + dy, z + dz);
+    }
+    found += hits;
+}
+
+static int _misses_start() {
+    // -1 where there are no hardware counters to read
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static bool _misses_stop(int fd, long long *misses) {
+#ifdef __linux__
+    if (fd < 0) return false;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    bool ok = read(fd, misses, sizeof(*misses)) == sizeof(*misses);
+    close(fd);
+    return ok;
+#else
+    (void) fd;
+    (void) misses;
+    return false;
+#endif
+}
+
+static void _run_phase(const char *name, void (*phase)(int)) {
+    _rewind();
+    int fd = _misses_start();
+    double start = profile_now();
+    for (int i = 0; i < config.bench_frames; i++) phase(i);
+    double ms = profile_now() - start;
+    long long misses = 0;
+    if (_misses_stop(fd, &misses))
+        printf("%s,%.3f,%lld\n", name, ms, misses);
+    else
+        printf("%s,%.3f,n/a\n", name, ms);
+}
+
+static void _run() {
+    int frames = config.bench_frames;
+    double *cpu = malloc(frames * sizeof(double));
+    double *finish = malloc(frames * sizeof(double));
+    assert_ok(cpu && finish, "could not allocate benchmark timings");
+    glut_hooks.swap_buffers = _swap_nothing;
+    init_scene();
+    glut_hooks.reshape(config.screen_width, config.screen_height);
+    // settle on the octree setting before measuring it
+    while (tuner_active()) {
+        _place(tuner_round() * frames / TUNER_ROUNDS);
+        glut_hooks.display();
+        glFinish();
+    }
+    _rewind();
+    printf("frame,cpu_ms,finish_ms\n");
+    for (int i = 0; i < frames; i++) {
+        _place(i);
+        double start = profile_now();
+        glut_hooks.display();
+        double issued = profile_now();
+        glFinish();
+        cpu[i] = issued - start;
+        finish[i] = profile_now() - issued;
+        printf("%d,%.3f,%.3f\n", i, cpu[i], finish[i]);
+    }
+    printf("phase,ms,main_thread_cache_misses\n");
+    _run_phase("cull", _cull);
+    _run_phase("settle", _settle);
+    _run_phase("collide", _collide);
+    fflush(stdout);
+    profile_summarize("cpu", cpu, frames);
+    profile_summarize("finish", finish, frames);
+    free(cpu);
+    free(finish);
+}
+
+#ifdef HAVE_EGL
+
+static EGLDisplay _open_display() {
+    // prefer Mesa's surfaceless platform, which needs no X or GBM device
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+            "eglGetPlatformDisplayEXT"
+        );
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (get_platform_display) {
+        display = get_platform_display(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL
+        );
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        log_error("could not initialize an EGL display");
+        return EGL_NO_DISPLAY;
+    }
+    return display;
+}
+
+bool bench_run() {
+    EGLDisplay display = _open_display();
+    if (display == EGL_NO_DISPLAY) return false;
+    // compatibility profile for the fixed function path
+    EGLint attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig egl_config = NULL;
+    EGLint count = 0;
+    eglBindAPI(EGL_OPENGL_API);
+    eglChooseConfig(display, attributes, &egl_config, 1, &count);
+    EGLContext context = eglCreateContext(
+        display, count ? egl_config : NULL, EGL_NO_CONTEXT, NULL
+    );
+    if (
+        context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)
+    ) {
+        log_error("could not make an EGL context current");
+        eglTerminate(display);
+        return false;
+    }
+    // render into a framebuffer sized like the window would be
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(
+        GL_RENDERBUFFER, GL_RGBA8, config.screen_width, config.screen_height
+    );
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]
+    );
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(
+        GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+        config.screen_width, config.screen_height
+    );
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]
+    );
+    bool complete =
+        glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        log_info(
+            "benchmarking %d frames at %dx%d on %s",
+            config.bench_frames, config.screen_width, config.screen_height,
+            glGetString(GL_RENDERER)
+        );
+        _run();
+    } else {
+        log_error("offscreen framebuffer incomplete");
+    }
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return complete;
+}
+
+#else
+
+bool bench_run() {
+    (void) _run;
+    log_error("built without EGL, headless benchmark unavailable");
+    return false;
+}
+
+#endif
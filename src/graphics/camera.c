@@ -0,0 +1,99 @@
+/**
+ * camera.c
+ *
+ * View and projection matrices built on the CPU, column-major like GL's, from
+ * view and player_pos. Culling reads them from here rather than querying the
+ * context, so it never waits on the driver and works without one; the display
+ * loads the same matrices into GL.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "graphics.h"
+
+extern Config config;
+extern Position player_pos;
+extern View view;
+
+static Matrix modelview = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static Matrix projection = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+static void _multiply(Matrix m, const Matrix r) {
+    // m = m * r, as glMultMatrixf would
+    Matrix product;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            product[col * 4 + row] = m[row] * r[col * 4]
+                + m[4 + row] * r[col * 4 + 1]
+                + m[8 + row] * r[col * 4 + 2]
+                + m[12 + row] * r[col * 4 + 3];
+        }
+    }
+    memcpy(m, product, sizeof(Matrix));
+}
+
+static void _rotate(Matrix m, float degrees, float x, float y, float z) {
+    // unit axis rotation, as glRotatef
+    float c = cosf(degrees / 180.0f * PI);
+    float s = sinf(degrees / 180.0f * PI);
+    float t = 1 - c;
+    Matrix r = {
+        t * x * x + c, t * x * y + s * z, t * x * z - s * y, 0,
+        t * x * y - s * z, t * y * y + c, t * y * z + s * x, 0,
+        t * x * z + s * y, t * y * z - s * x, t * z * z + c, 0,
+        0, 0, 0, 1
+    };
+    _multiply(m, r);
+}
+
+static void _translate(Matrix m, float x, float y, float z) {
+    for (int row = 0; row < 4; row++)
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+}
+
+void camera_perspective(float fovy, float aspect, float near, float far) {
+    // as gluPerspective
+    float f = 1 / tanf(fovy / 360.0f * PI);
+    memset(projection, 0, sizeof(Matrix));
+    projection[0] = f / aspect;
+    projection[5] = f;
+    projection[10] = (far + near) / (near - far);
+    projection[11] = -1;
+    projection[14] = 2 * far * near / (near - far);
+}
+
+void camera_update() {
+    // the player's view, or the oblique overhead one
+    Matrix m = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    if (config.overhead_view) {
+        _rotate(m, 57.5, 1.0, 0.0, 0.0);
+        _translate(
+            m,
+            -1.0f * WORLD_XZ / 2,
+            -2.45f * WORLD_Y,
+            -1.0f * WORLD_XZ - WORLD_XZ * 0.25f
+        );
+    } else {
+        _rotate(m, view.cam_x, 1.0, 0.0, 0.0);
+        _rotate(m, view.cam_y, 0.0, 1.0, 0.0);
+        _translate(m, player_pos.x, player_pos.y, player_pos.z);
+    }
+    memcpy(modelview, m, sizeof(Matrix));
+}
+
+void camera_eye(float eye[3]) {
+    // world position of the eye, undoing the rotation on the translation
+    for (int i = 0; i < 3; i++) {
+        eye[i] = -(modelview[i * 4] * modelview[12]
+            + modelview[i * 4 + 1] * modelview[13]
+            + modelview[i * 4 + 2] * modelview[14]);
+    }
+}
+
+const float *camera_modelview() {
+    return modelview;
+}
+
+const float *camera_projection() {
+    return projection;
+}
@@ -1,35 +1,73 @@
 #include <math.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#else
+#include <GL/glx.h>
+#endif
 #include "debug.h"
+#include "exec.h"
 #include "graphics.h"
+#include "world.h"
+
+typedef struct mesh_vertex {
+    GLfloat position[3];
+    GLubyte colour[4];
+} MeshVertex;
 
 extern Config config;
 extern GlutHooks glut_hooks;
-extern Laser lasers[];
+extern Laser player_laser;
 extern Position player_pos;
+extern Surface surface;
 extern View view;
 extern World world_terrain;
 extern World world_units;
 
 static float f[6][4];
-static int display_list[MAX_CUBES][3];
+static Block lists[2][MAX_CUBES];
+static Block *display_list = lists[0];
+static uint16_t sort_keys[MAX_CUBES];
+static MeshVertex *mesh = NULL;
+static int mesh_capacity = 0;
 static Material viewpoint_light = {-50.0f, -50.0f, -50.0f, 1.0};
 
+// unit cube faces wound counter-clockwise from outside, with their normals
+static const GLfloat cube_normals[24][3] = {
+    {1, 0, 0}, {1, 0, 0}, {1, 0, 0}, {1, 0, 0},
+    {-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0},
+    {0, 1, 0}, {0, 1, 0}, {0, 1, 0}, {0, 1, 0},
+    {0, -1, 0}, {0, -1, 0}, {0, -1, 0}, {0, -1, 0},
+    {0, 0, 1}, {0, 0, 1}, {0, 0, 1}, {0, 0, 1},
+    {0, 0, -1}, {0, 0, -1}, {0, 0, -1}, {0, 0, -1},
+};
+static const GLfloat cube_vertices[24][3] = {
+    {.5, -.5, -.5}, {.5, .5, -.5}, {.5, .5, .5}, {.5, -.5, .5},
+    {-.5, -.5, -.5}, {-.5, -.5, .5}, {-.5, .5, .5}, {-.5, .5, -.5},
+    {-.5, .5, -.5}, {-.5, .5, .5}, {.5, .5, .5}, {.5, .5, -.5},
+    {-.5, -.5, -.5}, {.5, -.5, -.5}, {.5, -.5, .5}, {-.5, -.5, .5},
+    {-.5, -.5, .5}, {.5, -.5, .5}, {.5, .5, .5}, {-.5, .5, .5},
+    {-.5, -.5, -.5}, {-.5, .5, -.5}, {.5, .5, -.5}, {.5, -.5, -.5},
+};
+
+static void _draw_solid_cube() {
+    // stands in for glutSolidCube(1.0), which needs a GLUT window
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, cube_vertices);
+    glNormalPointer(GL_FLOAT, 0, cube_normals);
+    glDrawArrays(GL_QUADS, 0, 24);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 static void _draw_cube(World *world, int x, int y, int z) {
-    Colour colour = (*world)[x][y][z];
-    if (colour == COLOUR_NONE) {
-        return;
-    } else if (colour == COLOUR_BLACK) {
-        // terrain
-        glMaterialfv(GL_FRONT, GL_SPECULAR, *get_material(COLOUR_WHITE));
-        glMaterialfv(GL_FRONT, GL_DIFFUSE, *get_material(COLOUR_BLACK));
-        glMaterialfv(GL_FRONT, GL_AMBIENT, *get_material(COLOUR_GREY3));
-    } else {
-        // npc
-        glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, *get_material(colour));
-    }
+    Colour colour = world_at(*world, x, y, z);
+    if (colour == COLOUR_NONE) return;
+    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, *get_material(colour));
     glPushMatrix();
     glTranslatef(x + 0.5f, y + 0.5f, z + 0.5f);
-    glutSolidCube(1.0);
+    _draw_solid_cube();
     glPopMatrix();
 }
 
@@ -72,29 +110,62 @@ static bool _cube_in_frustrum(float x, float y, float z, float n) {
     return true;
 }
 
-static void _draw_world() {
-    if (config.display_all_cubes || config.overhead_view) {
-        for (int x = 0; x < WORLD_XZ; x++) {
-            for (int y = 0; y < WORLD_Y; y++) {
-                for (int z = 0; z < WORLD_XZ; z++) {
-                    _draw_cube(&world_terrain, x, y, z);
+static int _build_mesh() {
+    // the listed blocks' faces turned towards the eye, in world space with
+    // their baked colours; returns the vertex count
+    int count = view.count * 24;
+    if (count > mesh_capacity) {
+        mesh_capacity = count * 2;
+        mesh = realloc(mesh, mesh_capacity * sizeof(MeshVertex));
+        assert_ok(mesh, "could not grow terrain mesh");
+    }
+    float eye[3];
+    camera_eye(eye);
+    MeshVertex *vertex = mesh;
+    for (int i = 0; i < view.count; i++) {
+        Block *block = &display_list[i];
+        const GLubyte *colours = lighting_block(block);
+        float origin[3] = {block->x, block->y, block->z};
+        float size[3] = {block->width, block->height, block->depth};
+        for (int face = 0; face < 24; face += 4) {
+            const GLfloat *n = cube_normals[face];
+            float facing = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                float corner = origin[axis]
+                    + (cube_vertices[face][axis] + 0.5f) * size[axis];
+                facing += n[axis] * (eye[axis] - corner);
+            }
+            if (facing <= 0) continue;
+            for (int v = face; v < face + 4; v++, vertex++) {
+                for (int axis = 0; axis < 3; axis++) {
+                    vertex->position[axis] = origin[axis]
+                        + (cube_vertices[v][axis] + 0.5f) * size[axis];
                 }
+                memcpy(vertex->colour, &colours[v * 4], 4);
             }
         }
-    } else {
-        build_display_list();
-        for (int i = 0; i < view.count; i++) {
-            _draw_cube(
-                &world_terrain,
-                display_list[i][0],
-                display_list[i][1],
-                display_list[i][2]
-            );
-        }
     }
+    return (int) (vertex - mesh);
+}
+
+static void _draw_world() {
+    // terrain lighting is baked into vertex colours, so draw it unlit
+    build_display_list();
+    if (!view.count) return;
+    int count = _build_mesh();
+    glDisable(GL_LIGHTING);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), mesh->position);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(MeshVertex), mesh->colour);
+    glDrawArrays(GL_QUADS, 0, count);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEnable(GL_LIGHTING);
 }
 
 static void _draw_units() {
+    glMaterialfv(GL_FRONT, GL_SPECULAR, *get_material(COLOUR_WHITE));
     for (int x = 0; x < WORLD_XZ; x++)
         for (int y = 0; y < WORLD_Y; y++)
             for (int z = 0; z < WORLD_XZ; z++)
@@ -126,6 +197,29 @@ static void _draw_laser(Laser *laser, Colour colour) {
     gluDeleteQuadric(quadric);
 }
 
+static void _set_swap_interval(int interval) {
+#ifdef __APPLE__
+    GLint value = interval;
+    CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &value);
+#else
+    typedef int (*SwapIntervalMESA)(unsigned);
+    typedef void (*SwapIntervalEXT)(Display *, GLXDrawable, int);
+    SwapIntervalMESA swap_mesa = (SwapIntervalMESA) glXGetProcAddressARB(
+        (const GLubyte *) "glXSwapIntervalMESA"
+    );
+    SwapIntervalEXT swap_ext = (SwapIntervalEXT) glXGetProcAddressARB(
+        (const GLubyte *) "glXSwapIntervalEXT"
+    );
+    if (swap_ext && glXGetCurrentDisplay()) {
+        swap_ext(glXGetCurrentDisplay(), glXGetCurrentDrawable(), interval);
+    } else if (swap_mesa) {
+        swap_mesa((unsigned) interval);
+    } else {
+        log("swap interval control unavailable");
+    }
+#endif
+}
+
 void start_game(int *argc, char **argv) {
     // exec display
     glutInit(argc, argv);
@@ -138,7 +232,24 @@ void start_game(int *argc, char **argv) {
         glutInitWindowSize(config.screen_width, config.screen_height);
         glutCreateWindow(argv[0]);
     }
-    // exec lighting
+    init_scene();
+    // register hooks
+    glutReshapeFunc(glut_hooks.reshape);
+    glutDisplayFunc(glut_hooks.display);
+    glutKeyboardFunc(glut_hooks.keyboard);
+    glutPassiveMotionFunc(glut_hooks.passive_motion);
+    glutMotionFunc(glut_hooks.motion);
+    glutMouseFunc(glut_hooks.mouse);
+    glutIdleFunc(glut_hooks.idle_update);
+    glutVisibilityFunc(glut_hooks.visibility);
+    _set_swap_interval(config.vsync ? 1 : 0);
+    fflush(stdout);
+    // start game loop
+    glutMainLoop();
+}
+
+void init_scene() {
+    // exec lighting, once a context is current
     Material light_position = {0.0, 50.0, 0.0, 0.0};
     glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, GL_TRUE);
     glLightfv(GL_LIGHT0, GL_AMBIENT, *get_material(COLOUR_GREY2));
@@ -154,66 +265,49 @@ void start_game(int *argc, char **argv) {
     glEnable(GL_LIGHT0);
     glEnable(GL_LIGHT1);
     glEnable(GL_DEPTH_TEST);
-    // register hooks
-    glutReshapeFunc(glut_hooks.reshape);
-    glutDisplayFunc(glut_hooks.display);
-    glutKeyboardFunc(glut_hooks.keyboard);
-    glutPassiveMotionFunc(glut_hooks.passive_motion);
-    glutMotionFunc(glut_hooks.motion);
-    glutMouseFunc(glut_hooks.mouse);
-    glutIdleFunc(glut_hooks.idle_update);
-    fflush(stdout);
+    glEnable(GL_NORMALIZE);  // merged terrain blocks are scaled
+    // exec fog, matched to the skybox so far terrain fades into it
+    glFogi(GL_FOG_MODE, GL_LINEAR);
+    glFogfv(GL_FOG_COLOR, *get_material(COLOUR_GREY3));
+    glFogf(GL_FOG_START, config.lod_near);
+    glFogf(GL_FOG_END, config.draw_distance);
     // initialize map
     map_pos_update();
-    // start game loop
-    glutMainLoop();
+    terrain_listen(map_terrain_changed);
+    terrain_listen(octree_terrain_changed);
+    if (config.autotune) tuner_start();
+    terrain_listen(lighting_terrain_changed);
+    // swap in the shader backend where the context can run it
+    if (config.renderer == RENDERER_SHADER && shader_init())
+        glut_hooks.display = glut_hook_shader__display;
 }
 
-void glut_hook_default__display() {
-    view.count = 0;
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+void place_camera() {
+    // view transform and the light that follows the player
+    camera_update();
+    glLoadMatrixf(camera_modelview());
     if (config.overhead_view) {
-        lasers[0].active = false;
-        glRotatef(57.5, 1.0, 0.0, 0.0);
+        player_laser.active = false;
         view.cam_x = 0;
         view.cam_y = 0;
-        glTranslatef(
-            -1.0f * WORLD_XZ / 2,
-            -2.45f * WORLD_Y,
-            -1.0f * WORLD_XZ - WORLD_XZ * 0.25f
-        );
         viewpoint_light[0] = WORLD_XZ / 2.0f;
         viewpoint_light[1] = WORLD_Y;
         viewpoint_light[2] = WORLD_XZ / 2.0f;
         int x = (int)player_pos.x * -1;
         int y = (int)player_pos.y * -1;
         int z = (int)player_pos.z * -1;
-        world_units[x][y][z] = COLOUR_BLUE;
+        world_at(world_units, x, y, z) = COLOUR_BLUE;
     } else {
-        glRotatef(view.cam_x, 1.0, 0.0, 0.0);
-        glRotatef(view.cam_y, 0.0, 1.0, 0.0);
-        glTranslatef(player_pos.x, player_pos.y, player_pos.z);
         viewpoint_light[0] = -player_pos.x;
         viewpoint_light[1] = -player_pos.y;
         viewpoint_light[2] = -player_pos.z;
     }
     glLightfv(GL_LIGHT1, GL_POSITION, viewpoint_light);
-    glShadeModel(GL_SMOOTH);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glPushMatrix();
-    glShadeModel(GL_SMOOTH);
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, *get_material(COLOUR_BLACK));
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, *get_material(COLOUR_GREY3));
+}
+
+void draw_overlay() {
+    // 2d layers in screen space over the finished scene
     glPushMatrix();
-    glTranslatef(WORLD_XZ / 2.0f, WORLD_Y / 2.0f, WORLD_XZ / 2.0f);
-    glutSolidCube(WORLD_XZ * 4.0f);
-    glPopMatrix();
-    glShadeModel(GL_SMOOTH);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, *get_material(COLOUR_BLACK));
-    _draw_world();
-    _draw_units();
-    shoot_laser();
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
@@ -230,207 +324,220 @@ void glut_hook_default__display() {
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix();
-    glutSwapBuffers();
-    glutPostRedisplay();
 }
 
-void tree(float bx, float by, float bz, float tx, float ty, float tz, int l) {
-    float length = (tx - bx) / 2.0f;
-    if (length < 0) length *= -1;
+const GLfloat (*get_cube_normals())[3] {
+    return cube_normals;
+}
+
+const GLfloat (*get_cube_vertices())[3] {
+    return cube_vertices;
+}
+
+Block *get_display_list() {
+    return display_list;
+}
+
+void glut_hook_default__display() {
+    double start = profile_now();
+    view.count = 0;
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    place_camera();
+    glShadeModel(GL_SMOOTH);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // clear the emission left by the 2d overlay
+    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, *get_material(COLOUR_BLACK));
+    if (config.fog) glEnable(GL_FOG);
+    _draw_world();
+    _draw_units();
+    shoot_laser();
+    // skybox last, so depth testing skips it wherever the scene covers it
+    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, *get_material(COLOUR_BLACK));
+    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, *get_material(COLOUR_GREY3));
+    glPushMatrix();
+    glTranslatef(-player_pos.x, -player_pos.y, -player_pos.z);
+    float sky = config.draw_distance * 2.0f;
+    glScalef(sky, sky, sky);
+    _draw_solid_cube();
+    glPopMatrix();
+    glDisable(GL_FOG);
+    draw_overlay();
+    glut_hooks.swap_buffers();
+    double ms = profile_now() - start;
+    profile_frame(ms);
+    tuner_frame(ms);
+}
+
+static float _distance_squared(float x, float z) {
+    float dx = x + player_pos.x;
+    float dz = z + player_pos.z;
+    return dx * dx + dz * dz;
+}
+
+static bool _box_in_frustrum(const Block *box) {
+    // test the corner furthest along each plane's normal
+    for (int p = 0; p < 6; p++) {
+        float x = box->x + (f[p][0] > 0 ? box->width : 0);
+        float y = box->y + (f[p][1] > 0 ? box->height : 0);
+        float z = box->z + (f[p][2] > 0 ? box->depth : 0);
+        if (f[p][0] * x + f[p][1] * y + f[p][2] * z + f[p][3] <= 0)
+            return false;
+    }
+    return true;
+}
+
+static void _add_block(int x, int y, int z, int width, int height, int depth) {
+    // leaves run concurrently, so reserve a slot atomically
+    int i = __atomic_fetch_add(&view.count, 1, __ATOMIC_RELAXED);
+    assert_lt(i, MAX_CUBES, "too many cubes to render");
+    display_list[i] = (Block) {x, y, z, width, height, depth};
+}
+
+static void _add_merged(int level, int bx, int bz, int by, int ty) {
+    // one box spanning the lowest to highest surface of a 2^level patch
+    int size = 1 << level;
+    int top = terrain_lod_max(level, bx >> level, bz >> level);
+    int bottom = terrain_lod_min(level, bx >> level, bz >> level);
+    if (top < by || top >= ty) return;  // owned by the leaf holding its top
+    int width = bx + size < WORLD_XZ ? size : WORLD_XZ - bx;
+    int depth = bz + size < WORLD_XZ ? size : WORLD_XZ - bz;
+    int height = top - bottom + 1;
+    int extent = width > height ? width : height;
     if (!_cube_in_frustrum(
-                bx + ((tx - bx) / 2),
-                by + ((ty - by) / 2),
-                bz + ((tz - bz) / 2),
-                length
-            )
-        ) return;
-    if (l != 1) {
-        float new_centre_x, new_centre_y, new_centre_z;
-        new_centre_x = bx + (tx - bx) / 2.0f;
-        new_centre_y = by + (ty - by) / 2.0f;
-        new_centre_z = bz + (tz - bz) / 2.0f;
-        l++;
-
-        // split the calculation up between threads
-        #pragma omp parallel sections
-        {
-            #pragma omp section
-            {
-                tree(bx, by, bz, new_centre_x, new_centre_y, new_centre_z, l);
-                tree(new_centre_x, by, bz, tx, new_centre_y, new_centre_z, l);
-                tree(bx, by, new_centre_z, new_centre_x, new_centre_y, tz, l);
-                tree(new_centre_x, by, new_centre_z, tx, new_centre_y, tz, l);
-            }
+            bx + width / 2.0f, bottom + height / 2.0f, bz + depth / 2.0f,
+            extent / 2.0f
+        )) return;
+    _add_block(bx, bottom, bz, width, height, depth);
+}
 
-            #pragma omp section
-            {
-                tree(bx, new_centre_y, bz, new_centre_x, ty, new_centre_z, l);
-                tree(new_centre_x, new_centre_y, bz, tx, ty, new_centre_z, l);
-                tree(bx, new_centre_y, new_centre_z, new_centre_x, ty, tz, l);
-                tree(new_centre_x, new_centre_y, new_centre_z, tx, ty, tz, l);
-            }
-        }
-        return;
+static void _add_leaf(const OctreeNode *leaf) {
+    // each patch of the coarsest level picks a single level of detail, so
+    // neighbouring levels never overlap; near patches draw the leaf's voxels
+    int patch = 1 << (TERRAIN_LOD_LEVELS - 1);
+    float reach = (float) config.draw_distance * config.draw_distance;
+    float near = (float) config.lod_near * config.lod_near;
+    float far = (float) config.lod_far * config.lod_far;
+    const Voxel *voxels = octree_voxels(leaf);
+    for (int i = 0; i < leaf->voxel_count; i++) {
+        Voxel v = voxels[i];
+        float distance = _distance_squared(
+            v.x / patch * patch + patch / 2.0f,
+            v.z / patch * patch + patch / 2.0f
+        );
+        if (distance >= near) continue;
+        if (!_cube_in_frustrum(v.x + 0.5f, v.y + 0.5f, v.z + 0.5f, 0.5))
+            continue;
+        _add_block(v.x, v.y, v.z, 1, 1, 1);
     }
-    for (int x = (int) bx; x < tx + 1; x++) {
-        for (int y = (int) by; y < ty + 1; y++) {
-            for (int z = (int) bz; z < tz + 1; z++) {
-                if (x >= WORLD_XZ || y >= WORLD_Y || z >= WORLD_XZ) continue;
-                if (
-                    x <= -1 || y <= -1 || z <= -1 || world_terrain[x][y][z] == 0
-                ) continue;
-                if (
-                    !_cube_in_frustrum(x + 0.5f, y + 0.5f, z + 0.5f, 0.5)
-                ) continue;
-                if (
-                    !((x > 0 && (x < WORLD_XZ - 1) && y > 0 &&
-                       (y < WORLD_Y - 1) && z > 0 && (z < WORLD_XZ - 1) &&
-                       (world_terrain[x + 1][y][z] == 0 ||
-                        world_terrain[x - 1][y][z] == 0 ||
-                        world_terrain[x][y + 1][z] == 0 ||
-                        (world_terrain[x][y - 1][z] == 0) ||
-                        world_terrain[x][y][z + 1] == 0 ||
-                        world_terrain[x][y][z - 1] == 0)) ||
-                      (x == 0 || x == WORLD_XZ - 1 || y == 0 ||
-                       y == WORLD_Y - 1 || z == 0 || z == WORLD_XZ - 1))
-                ) continue;
-                display_list[view.count][0] = x;
-                display_list[view.count][1] = y;
-                display_list[view.count][2] = z;
-                view.count++;
-                assert_lte(view.count, MAX_CUBES, "too many cubes to render");
-            }
+    const Block *cell = &leaf->cell;
+    int x_to = cell->x + cell->width;
+    int z_to = cell->z + cell->depth;
+    for (int x = cell->x; x < x_to && x < WORLD_XZ; x += patch) {
+        for (int z = cell->z; z < z_to && z < WORLD_XZ; z += patch) {
+            float distance = _distance_squared(
+                x + patch / 2.0f, z + patch / 2.0f
+            );
+            if (distance < near || distance > reach) continue;
+            int level = distance < far ? 1 : TERRAIN_LOD_LEVELS - 1;
+            int size = 1 << level;
+            for (int sx = x; sx < x + patch; sx += size)
+                for (int sz = z; sz < z + patch; sz += size)
+                    if (sx < WORLD_XZ && sz < WORLD_XZ)
+                        _add_merged(
+                            level, sx, sz, cell->y, cell->y + cell->height
+                        );
         }
     }
 }
 
-void frustrum_extract() {
-    float p[16];
-    float m[16];
-    float c[16];
-    float t;
-    glGetFloatv(GL_PROJECTION_MATRIX, p);
-    glGetFloatv(GL_MODELVIEW_MATRIX, m);
-    c[0] = m[0] * p[0] + m[1] * p[4] + m[2] * p[8] + m[3] * p[12];
-    c[1] = m[0] * p[1] + m[1] * p[5] + m[2] * p[9] + m[3] * p[13];
-    c[2] = m[0] * p[2] + m[1] * p[6] + m[2] * p[10] + m[3] * p[14];
-    c[3] = m[0] * p[3] + m[1] * p[7] + m[2] * p[11] + m[3] * p[15];
-    c[4] = m[4] * p[0] + m[5] * p[4] + m[6] * p[8] + m[7] * p[12];
-    c[5] = m[4] * p[1] + m[5] * p[5] + m[6] * p[9] + m[7] * p[13];
-    c[6] = m[4] * p[2] + m[5] * p[6] + m[6] * p[10] + m[7] * p[14];
-    c[7] = m[4] * p[3] + m[5] * p[7] + m[6] * p[11] + m[7] * p[15];
-    c[8] = m[8] * p[0] + m[9] * p[4] + m[10] * p[8] + m[11] * p[12];
-    c[9] = m[8] * p[1] + m[9] * p[5] + m[10] * p[9] + m[11] * p[13];
-    c[10] = m[8] * p[2] + m[9] * p[6] + m[10] * p[10] + m[11] * p[14];
-    c[11] = m[8] * p[3] + m[9] * p[7] + m[10] * p[11] + m[11] * p[15];
-    c[12] = m[12] * p[0] + m[13] * p[4] + m[14] * p[8] + m[15] * p[12];
-    c[13] = m[12] * p[1] + m[13] * p[5] + m[14] * p[9] + m[15] * p[13];
-    c[14] = m[12] * p[2] + m[13] * p[6] + m[14] * p[10] + m[15] * p[14];
-    c[15] = m[12] * p[3] + m[13] * p[7] + m[14] * p[11] + m[15] * p[15];
-    f[0][0] = c[3] - c[0];
-    f[0][1] = c[7] - c[4];
-    f[0][2] = c[11] - c[8];
-    f[0][3] = c[15] - c[12];
-
-    // split the calculation up between threads
-    #pragma omp parallel sections private(t)
-    {
-        #pragma omp section
-        {
-            t = sqrtf(
-                f[0][0] * f[0][0] + f[0][1] * f[0][1] + f[0][2] * f[0][2]
-            );
-            f[0][0] /= t;
-            f[0][1] /= t;
-            f[0][2] /= t;
-            f[0][3] /= t;
-        }
+static void _add_leaves(int from, int to, void *arg) {
+    const OctreeNode **leaves = arg;
+    for (int i = from; i < to; i++) _add_leaf(leaves[i]);
+}
 
-        #pragma omp section
-        {
-            f[1][0] = c[3] + c[0];
-            f[1][1] = c[7] + c[4];
-            f[1][2] = c[11] + c[8];
-            f[1][3] = c[15] + c[12];
-            t = sqrtf(
-                f[1][0] * f[1][0] + f[1][1] * f[1][1] + f[1][2] * f[1][2]
-            );
-            f[1][0] /= t;
-            f[1][1] /= t;
-            f[1][2] /= t;
-            f[1][3] /= t;
-        }
+static bool _node_visible(const Block *b) {
+    // in the frustrum and not wholly beyond the draw distance
+    if (!_box_in_frustrum(b)) return false;
+    float nx = fminf(fmaxf(-player_pos.x, b->x), b->x + b->width);
+    float nz = fminf(fmaxf(-player_pos.z, b->z), b->z + b->depth);
+    float reach = (float) config.draw_distance * config.draw_distance;
+    return _distance_squared(nx, nz) <= reach;
+}
 
-        #pragma omp section
-        {
-            f[2][0] = c[3] + c[1];
-            f[2][1] = c[7] + c[5];
-            f[2][2] = c[11] + c[9];
-            f[2][3] = c[15] + c[13];
-            t = sqrtf(
-                f[2][0] * f[2][0] + f[2][1] * f[2][1] + f[2][2] * f[2][2]
-            );
-            f[2][0] /= t;
-            f[2][1] /= t;
-            f[2][2] /= t;
-            f[2][3] /= t;
-        }
+static void _list_visible() {
+    // gather the visible leaves, then fill them in across the job workers
+    int count;
+    const OctreeNode **leaves = octree_leaves(_node_visible, &count);
+    jobs_parallel_for(0, count, 4, _add_leaves, leaves);
+}
 
-        #pragma omp section
-        {
-            f[3][0] = c[3] - c[1];
-            f[3][1] = c[7] - c[5];
-            f[3][2] = c[11] - c[9];
-            f[3][3] = c[15] - c[13];
-            t = sqrtf(
-                f[3][0] * f[3][0] + f[3][1] * f[3][1] + f[3][2] * f[3][2]
-            );
-            f[3][0] /= t;
-            f[3][1] /= t;
-            f[3][2] /= t;
-            f[3][3] /= t;
+void frustrum_extract() {
+    const float *p = camera_projection();
+    const float *m = camera_modelview();
+    float c[16];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            c[i * 4 + j] = m[i * 4] * p[j] + m[i * 4 + 1] * p[4 + j]
+                + m[i * 4 + 2] * p[8 + j] + m[i * 4 + 3] * p[12 + j];
         }
-
-        #pragma omp section
-        {
-            f[4][0] = c[3] - c[2];
-            f[4][1] = c[7] - c[6];
-            f[4][2] = c[11] - c[10];
-            f[4][3] = c[15] - c[14];
-            t = sqrtf(
-                f[4][0] * f[4][0] + f[4][1] * f[4][1] + f[4][2] * f[4][2]
-            );
-            f[4][0] /= t;
-            f[4][1] /= t;
-            f[4][2] /= t;
-            f[4][3] /= t;
+    }
+    // planes: right, left, bottom, top, far, near
+    static const int axis[6] = {0, 0, 1, 1, 2, 2};
+    static const float sign[6] = {-1, 1, 1, -1, -1, 1};
+    for (int n = 0; n < 6; n++) {
+        for (int i = 0; i < 4; i++) {
+            f[n][i] = c[i * 4 + 3] + sign[n] * c[i * 4 + axis[n]];
         }
+        float t = sqrtf(
+            f[n][0] * f[n][0] + f[n][1] * f[n][1] + f[n][2] * f[n][2]
+        );
+        for (int i = 0; i < 4; i++) f[n][i] /= t;
+    }
+}
 
-        #pragma omp section
-        {
-            f[5][0] = c[3] + c[2];
-            f[5][1] = c[7] + c[6];
-            f[5][2] = c[11] + c[10];
-            f[5][3] = c[15] + c[14];
-            t = sqrtf(
-                f[5][0] * f[5][0] + f[5][1] * f[5][1] + f[5][2] * f[5][2]
-            );
-            f[5][0] /= t;
-            f[5][1] /= t;
-            f[5][2] /= t;
-            f[5][3] /= t;
-        }
+static void _list_surface() {
+    // every surface voxel, unculled
+    assert_lte(surface.count, MAX_CUBES, "too many cubes to render");
+    for (int i = 0; i < surface.count; i++) {
+        Voxel voxel = surface.voxels[i];
+        display_list[i] = (Block) {voxel.x, voxel.y, voxel.z, 1, 1, 1};
+    }
+    view.count = surface.count;
+}
+
+static void _sort_front_to_back() {
+    // counting sort on whole-unit distances from the eye to each block's
+    // centre, so near terrain fills the depth buffer before what it hides
+    int starts[SORT_BUCKETS + 1] = {0};
+    float eye[3];
+    camera_eye(eye);
+    for (int i = 0; i < view.count; i++) {
+        Block *block = &display_list[i];
+        float dx = block->x + block->width / 2.0f - eye[0];
+        float dy = block->y + block->height / 2.0f - eye[1];
+        float dz = block->z + block->depth / 2.0f - eye[2];
+        int key = (int) sqrtf(dx * dx + dy * dy + dz * dz);
+        sort_keys[i] = key < SORT_BUCKETS ? key : SORT_BUCKETS - 1;
+        starts[sort_keys[i] + 1]++;
     }
+    for (int k = 0; k < SORT_BUCKETS; k++) starts[k + 1] += starts[k];
+    Block *sorted = display_list == lists[0] ? lists[1] : lists[0];
+    for (int i = 0; i < view.count; i++)
+        sorted[starts[sort_keys[i]]++] = display_list[i];
+    display_list = sorted;
 }
 
 void build_display_list() {
     frustrum_extract();
     view.count = 0;
-    tree(0, 0, 0, WORLD_XZ, WORLD_Y, WORLD_XZ, 0);
+    if (config.display_all_cubes || config.overhead_view) _list_surface();
+    else _list_visible();
+    _sort_front_to_back();
 }
 
 void shoot_laser() {
-    Laser *laser = &lasers[0];
+    Laser *laser = &player_laser;
     if (laser->active) {
         float rot_x = (view.cam_x / 180.0f * PI);
         float rot_y = (view.cam_y / 180.0f * PI);
@@ -444,8 +551,8 @@ void shoot_laser() {
         laser->to.z = cosf(rot_y) * -100 - player_pos.z - laser->from.z;
         _draw_laser(laser, COLOUR_YELLOW);
     }
-    for (uint8 i = 0; i < UNIT_COUNT; i++) {
-        laser = &lasers[i + 1];
+    for (int i = 0; i < laser_pool_size(); i++) {
+        laser = laser_get(i);
         if (laser->active) _draw_laser(laser, COLOUR_RED);
     }
 }
@@ -1,14 +1,19 @@
 #include <math.h>
+#include <unistd.h>
 #include "debug.h"
 #include "exec.h"
 #include "graphics.h"
+#include "world.h"
 
 extern Config config;
-extern Laser lasers[];
+extern Laser player_laser;
 extern Position player_pos;
 extern View view;
 extern World world_terrain;
 
+static bool redraw = true;
+static bool visible = true;
+
 static Coordinate pos_to_coord(Position pos) {
     return (Coordinate) {
         (int) pos.x, (int) pos.y, (int) pos.z
@@ -28,14 +33,14 @@ static bool _has_collided(Coordinate coord) {
                 if (z <= 0 || z >= WORLD_XZ) return true;
                 if (y <= 0 || y >= WORLD_Y) return true;
                 // check for cube
-                if (world_terrain[x][y][z] != COLOUR_NONE) return true;
+                if (world_at(world_terrain, x, y, z)) return true;
             }
         }
     }
     return false;
 }
 
-static void _calc_player_move(Direction direction) {
+static bool _calc_player_move(Direction direction) {
     Position player_pos_next = player_pos;
     static float accel_x = 0.0f;
     static float accel_y = 0.0f;
@@ -82,22 +87,25 @@ static void _calc_player_move(Direction direction) {
         accel_x = 0;
         accel_y = 0;
         accel_z = 0;
-        return;
+        return false;
     }
-    // decay acceleration
+    // decay acceleration, settling once drift is no longer visible
     float decay = config.traction ? 2 : 1.025f;
-    accel_x /= decay;
-    accel_y /= decay;
-    accel_z /= decay;
+    accel_x = fabsf(accel_x) < DRIFT_EPSILON ? 0 : accel_x / decay;
+    accel_y = fabsf(accel_y) < DRIFT_EPSILON ? 0 : accel_y / decay;
+    accel_z = fabsf(accel_z) < DRIFT_EPSILON ? 0 : accel_z / decay;
     // idle_update position if changed
+    bool moved = player_pos.x != player_pos_next.x ||
+        player_pos.y != player_pos_next.y ||
+        player_pos.z != player_pos_next.z;
     player_pos = player_pos_next;
+    return moved;
 }
 
 void glut_hook_default__draw_2d() {
     // note: layers overlay in the reverse order
-    map_player_layer();  // e.g. player is drawn above terrain
-    if (lasers[0].active) map_laser_layer();  // same with laser, etc...
-    map_npc_layer();
+    map_marker_layer();  // e.g. player and npcs are drawn above terrain
+    if (player_laser.active) map_laser_layer();  // same with laser, etc...
     map_outline_layer();
     map_terrain_layer();
 }
@@ -105,33 +113,77 @@ void glut_hook_default__draw_2d() {
 void glut_hook_default__idle_update() {
     static int laser_base = 0;
     static int timer_base = 0;
+    static int frame_base = 0;
     static int frame = 0;
+    static int scenario_base = -1;
     // calculate time delta
     int time = glutGet(GLUT_ELAPSED_TIME);
-    frame++;
-    bool next_tick = time - timer_base > 100 / GAME_SPEED;
+    // play back a scripted flythrough, quitting once it ends
+    if (config.scenario_file) {
+        if (scenario_base < 0) {
+            scenario_base = time;
+            profile_record(true);
+        }
+        if (!scenario_apply(time - scenario_base)) {
+            profile_record(false);
+            log("exiting");
+            unit_rm_all();
+            glutDestroyWindow(glutGetWindow());
+            exit(0);
+        }
+        redraw = true;
+    }
+    int tick_interval = 100 / GAME_SPEED;
+    bool next_tick = time - timer_base > tick_interval;
     // log profiling information
     if (next_tick && config.show_fps) log_fps(frame, time, timer_base);
-    // reset lasers[0] cooldown
+    // reset player_laser cooldown
     bool laser_cooldown = time - laser_base > 350;
-    if (!lasers[0].active) {
+    if (!player_laser.active) {
         laser_base = time;
     } else if (laser_cooldown) {
-        lasers[0].active = false;
+        player_laser.active = false;
         laser_base = time;
+        redraw = true;
     }
     // apply player movement
-    _calc_player_move(DIRECTION_COAST);
-    if (!next_tick && !config.timer_unlock) return;
-    // reset time base
-    timer_base = time;
-    frame = 0;
-    // trigger unit movement
-    unit_cycle();
+    if (_calc_player_move(DIRECTION_COAST)) redraw = true;
+    // carry on with any terrain edits
+    if (terrain_update()) redraw = true;
+    if (next_tick || config.timer_unlock) {
+        // reset time base
+        timer_base = time;
+        frame = 0;
+        // trigger unit movement
+        double start = profile_now();
+        if (config.stream && stream_update()) redraw = true;
+        if (config.watch && terrain_poll()) redraw = true;
+        if (unit_cycle()) redraw = true;
+        profile_tick(profile_now() - start);
+    }
+    profile_report();
+    // only draw when something changed and the frame budget allows it
+    int frame_interval =
+        config.vsync || config.fps_cap <= 0 ? 0 : 1000 / config.fps_cap;
+    if (redraw && visible && time - frame_base >= frame_interval) {
+        frame_base = time;
+        frame++;
+        redraw = false;
+        glutPostRedisplay();
+        return;
+    }
+    if (config.timer_unlock) return;
+    // otherwise sleep until the next tick or frame is due
+    int wait = timer_base + tick_interval + 1 - time;
+    if (visible && wait > IDLE_SLEEP_MAX) wait = IDLE_SLEEP_MAX;
+    if (redraw && visible && frame_base + frame_interval - time < wait)
+        wait = frame_base + frame_interval - time;
+    if (wait > 0) usleep((useconds_t) wait * 1000);
 }
 
 void glut_hook_default__keyboard(unsigned char key, int x, int y) {
     Direction direction = DIRECTION_COAST;
+    redraw = true;
     switch (key) {
         case 'q':
         case 27:
@@ -200,8 +252,18 @@ void glut_hook_default__keyboard(unsigned char key, int x, int y) {
                 config.fly_control ? "ON" : "OFF"
             );
             break;
+        case 'l':
+            if (terrain_reload()) puts("terrain reloaded");
+            break;
+        case 'g':
+            config.fog = !config.fog;
+            printf(
+                "fog set to %s\n",
+                config.fog ? "ON" : "OFF"
+            );
+            break;
         case ' ':
-            lasers[0].active = true;  // in class prof. said to activate w/ space
+            player_laser.active = true;  // in class prof. said to activate w/ space
             break;
         default:
             break;
@@ -215,11 +277,13 @@ void glut_hook_default__motion(int x, int y) {
     view.cam_y += x - view.old_x;
     view.old_x = x;
     view.old_y = y;
+    redraw = true;
 }
 
 void glut_hook_default__mouse(int button, int state, int x, int y) {
     if (button != 0 || state != 0) return;
-    lasers[0].active = true;  // spec says to use mouse so that's used too
+    redraw = true;
+    player_laser.active = true;  // spec says to use mouse so that's used too
 }
 
 void glut_hook_default__passive_motion(int x, int y) {
@@ -228,16 +292,26 @@ void glut_hook_default__passive_motion(int x, int y) {
     view.cam_y += x - view.old_x;
     view.old_x = x;
     view.old_y = y;
+    redraw = true;
 }
 
 void glut_hook_default__reshape(int w, int h) {
     glViewport(0, 0, (GLsizei) w, (GLsizei) h);
     glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0, (GLfloat) w / (GLfloat) h, 0.1, WORLD_XZ * 4);
+    // far enough to take in the skybox's corners around the draw distance
+    camera_perspective(
+        45.0, (GLfloat) w / (GLfloat) h, 0.1, config.draw_distance * 2.0f
+    );
+    glLoadMatrixf(camera_projection());
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     config.screen_width = w;
     config.screen_height = h;
     map_pos_update();
+    redraw = true;
+}
+
+void glut_hook_default__visibility(int state) {
+    visible = state == GLUT_VISIBLE;
+    redraw = true;
 }
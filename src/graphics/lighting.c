@@ -0,0 +1,111 @@
+/**
+ * lighting.c
+ *
+ * Terrain lighting baked into per-vertex colours whenever the terrain
+ * changes, so the terrain pass can be drawn unlit. Every face gets a fixed
+ * ambient term plus a directional sun, and each of its corners is darkened
+ * by the solid voxels around it (ambient occlusion). Columns hold a surface
+ * cube and at most a floor cube beneath it, each baked in full; merged
+ * distant blocks only get the per-face sun shading.
+ */
+
+#include <math.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+
+#define _CUBE_VERTICES 24
+
+typedef GLubyte CubeColours[_CUBE_VERTICES][4];
+
+typedef struct bounds {
+    int z0;
+    int z1;
+} Bounds;
+
+extern Surface surface;
+
+static const float sun[3] = {0.32f, 0.9f, 0.29f};
+static const float occlusion[4] = {0.45f, 0.65f, 0.82f, 1.0f};
+static CubeColours column_colours[WORLD_XZ][WORLD_XZ][2];
+static CubeColours block_colours;
+
+static float _sun_shade(const GLfloat normal[3]) {
+    float length = sqrtf(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+    float lambert = (normal[0] * sun[0] + normal[1] * sun[1]
+        + normal[2] * sun[2]) / length;
+    return LIGHT_AMBIENT + LIGHT_SUN * (lambert > 0 ? lambert : 0);
+}
+
+static int _occlusion(
+    int x, int y, int z, const GLfloat *n, const GLfloat *v
+) {
+    // the two voxels beside a face corner and the one diagonal to it, out in
+    // front of the face; both sides solid hides the corner fully
+    int p[3] = {x + (int) n[0], y + (int) n[1], z + (int) n[2]};
+    int side[2][3], corner[3];
+    int found = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        corner[axis] = p[axis];
+        side[0][axis] = side[1][axis] = p[axis];
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        if (n[axis] != 0) continue;
+        int step = v[axis] > 0 ? 1 : -1;
+        side[found++][axis] += step;
+        corner[axis] += step;
+    }
+    bool a = terrain_solid(side[0][0], side[0][1], side[0][2]);
+    bool b = terrain_solid(side[1][0], side[1][1], side[1][2]);
+    bool c = terrain_solid(corner[0], corner[1], corner[2]);
+    return a && b ? 0 : 3 - a - b - c;
+}
+
+static void _bake_cube(int x, int y, int z, CubeColours colours) {
+    const GLfloat (*normals)[3] = get_cube_normals();
+    const GLfloat (*vertices)[3] = get_cube_vertices();
+    for (int i = 0; i < _CUBE_VERTICES; i++) {
+        int ao = _occlusion(x, y, z, normals[i], vertices[i]);
+        float shade = _sun_shade(normals[i]) * occlusion[ao];
+        GLubyte value = (GLubyte) (shade > 1 ? 255 : shade * 255);
+        colours[i][0] = colours[i][1] = colours[i][2] = value;
+        colours[i][3] = 255;
+    }
+}
+
+static void _bake_columns(int from, int to, void *arg) {
+    Bounds *bounds = arg;
+    for (int x = from; x < to; x++) {
+        for (int z = bounds->z0; z < bounds->z1; z++) {
+            _bake_cube(x, surface.heights[x][z], z, column_colours[x][z][0]);
+            if (terrain_solid(x, 0, z))
+                _bake_cube(x, 0, z, column_colours[x][z][1]);
+        }
+    }
+}
+
+const GLubyte *lighting_block(Block *block) {
+    if (block->width != 1 || block->height != 1 || block->depth != 1)
+        return &block_colours[0][0];
+    int floor = block->y != surface.heights[block->x][block->z];
+    return &column_colours[block->x][block->z][floor][0][0];
+}
+
+void lighting_terrain_changed(int x0, int z0, int x1, int z1) {
+    const GLfloat (*normals)[3] = get_cube_normals();
+    for (int i = 0; i < _CUBE_VERTICES; i++) {
+        GLubyte value = (GLubyte) (_sun_shade(normals[i]) * 255);
+        block_colours[i][0] = block_colours[i][1] = value;
+        block_colours[i][2] = value;
+        block_colours[i][3] = 255;
+    }
+    // corners see into neighbouring columns, so rebake a column further out
+    Bounds bounds = {z0 > 0 ? z0 - 1 : 0, z1 < WORLD_XZ ? z1 + 1 : WORLD_XZ};
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    x1 = x1 < WORLD_XZ ? x1 + 1 : WORLD_XZ;
+    jobs_parallel_for(x0, x1, 8, _bake_columns, &bounds);
+}
+
+const float *lighting_sun() {
+    return sun;
+}
@@ -1,14 +1,23 @@
 #include <math.h>
+#include <string.h>
 #include "debug.h"
+#include "exec.h"
 #include "graphics.h"
+#include "world.h"
 
 extern Config config;
-extern Laser lasers[];
+extern Laser player_laser;
 extern Position player_pos;
 extern View view;
-extern World world_terrain;
+extern SolidMask world_solid;
 extern World world_units;
 
+static GLuint texture = 0;
+static GLubyte texels[WORLD_XZ][WORLD_XZ];
+static int stale[4] = {0, 0, 0, 0};
+static GLfloat quad[4][4];
+static GLfloat marker_vertices[(WORLD_XZ * WORLD_XZ + 1) * 6][2];
+static GLfloat marker_colours[(WORLD_XZ * WORLD_XZ + 1) * 6][4];
 static float alpha;
 static float dim;
 static float pt;
@@ -55,6 +64,14 @@ void map_pos_update() {
             break;
     }
     pt = dim / (float) WORLD_XZ;
+    // the terrain texture spans the map, x across and z up
+    float right = pt_nw_x + WORLD_XZ * pt;
+    float top = pt_se_y + WORLD_XZ * pt;
+    GLfloat corners[4][4] = {
+        {pt_nw_x, pt_se_y, 0, 0}, {right, pt_se_y, 1, 0},
+        {right, top, 1, 1}, {pt_nw_x, top, 0, 1}
+    };
+    memcpy(quad, corners, sizeof(quad));
 }
 
 void map_mode_toggle() {
@@ -79,75 +96,160 @@ void map_outline_layer() {
     glEnd();
 }
 
-void map_terrain_layer() {
-    glBegin(GL_QUADS);
-    float px_x, px_y;
-    float map_height;
-    for (int z = 0; z < WORLD_XZ; z++) {
-        for (int x = 0; x < WORLD_XZ; x++) {
-            int y;
-            for (y = WORLD_Y - 1; y >= 0; y--) {
-                if (world_terrain[x][y][z] != COLOUR_NONE) break;
+static void _find_column_tops(int from, int to, void *arg) {
+    // shade each texel by the height of the column's top, found by walking
+    // down a whole row of columns at once until every one has hit something
+    const int *bounds = arg;
+    for (int x = from; x < to; x++) {
+        int tops[WORLD_XZ];
+        uint64_t pending[SOLID_WORDS] = {0};
+        int left = 0;
+        for (int z = bounds[0]; z < bounds[1]; z++) {
+            tops[z] = -1;
+            pending[z >> 6] |= 1ull << (z & 63);
+            left++;
+        }
+        for (int y = WORLD_Y - 1; y >= 0 && left; y--) {
+            for (int w = 0; w < SOLID_WORDS; w++) {
+                uint64_t hits = world_solid[x][y][w] & pending[w];
+                pending[w] &= ~hits;
+                for (; hits; hits &= hits - 1, left--)
+                    tops[w * 64 + __builtin_ctzll(hits)] = y;
             }
-            px_x = pt_nw_x + x * pt;
-            map_height = y / (WORLD_Y + 1.0f) * 255 / 100.0f;
-            px_y = pt_se_y + z * pt;
-            _set_2d_material(
-                &((Material) {
-                    map_height, map_height, map_height, alpha / 2
-                }));
-            glVertex2f(px_x, px_y);
-            glVertex2f(px_x + pt, px_y);
-            glVertex2f(px_x + pt, px_y + pt);
-            glVertex2f(px_x, px_y + pt);
         }
+        for (int z = bounds[0]; z < bounds[1]; z++) {
+            float shade = tops[z] / (WORLD_Y + 1.0f) * 255 / 100.0f;
+            texels[z][x] = (GLubyte) (shade < 1 ? shade * 255 : 255);
+        }
+    }
+}
+
+static void _upload_texels() {
+    // the first upload sends the whole map, later ones just what changed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (!texture) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_LUMINANCE, WORLD_XZ, WORLD_XZ, 0,
+            GL_LUMINANCE, GL_UNSIGNED_BYTE, texels
+        );
+    } else if (stale[0] < stale[2]) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, WORLD_XZ);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, stale[0]);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, stale[1]);
+        glTexSubImage2D(
+            GL_TEXTURE_2D, 0, stale[0], stale[1], stale[2] - stale[0],
+            stale[3] - stale[1], GL_LUMINANCE, GL_UNSIGNED_BYTE, texels
+        );
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    stale[0] = stale[1] = stale[2] = stale[3] = 0;
+}
+
+void map_terrain_changed(int x0, int z0, int x1, int z1) {
+    // texels only change with the terrain, so they're kept between frames and
+    // sent to the texture on the next draw
+    int bounds[2] = {z0, z1};
+    jobs_parallel_for(x0, x1, 16, _find_column_tops, bounds);
+    if (stale[0] < stale[2]) {
+        x0 = x0 < stale[0] ? x0 : stale[0];
+        z0 = z0 < stale[1] ? z0 : stale[1];
+        x1 = x1 > stale[2] ? x1 : stale[2];
+        z1 = z1 > stale[3] ? z1 : stale[3];
+    }
+    stale[0] = x0;
+    stale[1] = z0;
+    stale[2] = x1;
+    stale[3] = z1;
+}
+
+void map_terrain_layer() {
+    if (dim <= 0) return;
+    _upload_texels();
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1, 1, 1, alpha / 2);
+    glBegin(GL_QUADS);
+    for (int i = 0; i < 4; i++) {
+        glTexCoord2f(quad[i][2], quad[i][3]);
+        glVertex2f(quad[i][0], quad[i][1]);
     }
     glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_LIGHTING);
 }
 
-void map_player_layer() {
+static int _add_marker(int n, float (*corners)[2], int count, Material c) {
+    // markers are triangles or quads, the latter split in two
+    static const int order[2][6] = {{0, 1, 2}, {0, 1, 2, 0, 2, 3}};
+    for (int i = 0; i < (count == 3 ? 3 : 6); i++, n++) {
+        const float *corner = corners[order[count == 4][i]];
+        memcpy(marker_vertices[n], corner, sizeof(marker_vertices[n]));
+        memcpy(marker_colours[n], c, sizeof(marker_colours[n]));
+    }
+    return n;
+}
+
+void map_marker_layer() {
+    // the player and npcs in one draw, the player first so it stays on top
+    if (dim <= 0) return;
+    int n = 0;
     float px_size = pt * 4;
     float px_x = pt_nw_x - player_pos.x * pt;
     float px_y = pt_nw_y + player_pos.z * pt;
-    glBegin(GL_TRIANGLES);
-    _set_2d_colour(COLOUR_RED, alpha * 1.5f);
-    glVertex2f(px_x, px_y + px_size);
-    glVertex2f(px_x + px_size, px_y - px_size);
-    glVertex2f(px_x - px_size, px_y - px_size);
-    glEnd();
-}
-
-void map_npc_layer() {
-    float px_size = pt * 1.5f;
-    float px_x, px_y;
+    Material *red = get_material_a(COLOUR_RED, alpha * 1.5f);
+    n = _add_marker(n, (float [3][2]) {
+        {px_x, px_y + px_size},
+        {px_x + px_size, px_y - px_size},
+        {px_x - px_size, px_y - px_size}
+    }, 3, *red);
+    px_size = pt * 1.5f;
     for (int z = 0; z < WORLD_XZ; z++) {
         for (int x = 0; x < WORLD_XZ; x++) {
             int y;
             for (y = WORLD_Y - 1; y >= 0; y--) {
-                if (world_units[x][y][z] == COLOUR_NONE) continue;
+                if (world_at(world_units, x, y, z) == COLOUR_NONE) continue;
                 px_x = pt_nw_x + x * pt;
                 px_y = pt_nw_y - z * pt;
-                glBegin(GL_QUADS);
-                _set_2d_colour(
-                    COLOUR_GREEN,
-                    0.125f + (float) (WORLD_Y - y) / WORLD_Y
+                Material *green = get_material_a(
+                    COLOUR_GREEN, 0.125f + (float) (WORLD_Y - y) / WORLD_Y
                 );
-                glVertex2f(px_x - px_size, px_y - px_size);
-                glVertex2f(px_x + px_size, px_y - px_size);
-                glVertex2f(px_x + px_size, px_y + px_size);
-                glVertex2f(px_x - px_size, px_y + px_size);
-                glEnd();
+                n = _add_marker(n, (float [4][2]) {
+                    {px_x - px_size, px_y - px_size},
+                    {px_x + px_size, px_y - px_size},
+                    {px_x + px_size, px_y + px_size},
+                    {px_x - px_size, px_y + px_size}
+                }, 4, *green);
                 break;
             }
         }
     }
+    glDisable(GL_LIGHTING);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, marker_vertices);
+    glColorPointer(4, GL_FLOAT, 0, marker_colours);
+    glDrawArrays(GL_TRIANGLES, 0, n);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEnable(GL_LIGHTING);
 }
 
 void map_laser_layer() {
-    float p1_x = pt_nw_x + lasers[0].from.x * pt;
-    float p1_y = pt_nw_y - lasers[0].from.z * pt;
-    float p2_x = p1_x - lasers[0].to.x * pt;
-    float p2_y = p1_y + lasers[0].to.z * pt;
+    float p1_x = pt_nw_x + player_laser.from.x * pt;
+    float p1_y = pt_nw_y - player_laser.from.z * pt;
+    float p2_x = p1_x - player_laser.to.x * pt;
+    float p2_y = p1_y + player_laser.to.z * pt;
     glBegin(GL_LINES);
     glLineWidth(pt);
     _set_2d_colour(COLOUR_YELLOW, alpha * 1.5f);
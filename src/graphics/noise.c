@@ -0,0 +1,132 @@
+/**
+ * noise.c
+ *
+ * Seeded fractal (fBm) gradient noise for synthetic heightmaps. Output goes
+ * into the shared Pgm so generated worlds take the same resample and settle
+ * path as loaded ones. Each row depends only on its index and the parameters,
+ * so results are reproducible whatever the worker count.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+
+#define _MAX_OCTAVES 12
+
+typedef struct fbm {
+    int size;
+    int octaves;
+    uint32_t seed;
+    float frequency;
+    float persistence;
+    float amplitude;
+} Fbm;
+
+extern Pgm terrain;
+
+static inline uint32_t _hash(uint32_t x, uint32_t z, uint32_t seed) {
+    uint32_t h = x * 0x8da6b343u ^ z * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    return h ^ h >> 15;
+}
+
+static inline float _fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static void _hash_gradients(
+    float *restrict gx, float *restrict gz, int count, uint32_t iz,
+    uint32_t seed
+) {
+    // pseudo-random gradients in [-1, 1]^2 along one row of the lattice
+    for (int i = 0; i < count; i++) {
+        uint32_t h = _hash((uint32_t) i, iz, seed);
+        gx[i] = (float) (h & 0xffff) * (2.0f / 65535.0f) - 1.0f;
+        gz[i] = (float) (h >> 16) * (2.0f / 65535.0f) - 1.0f;
+    }
+}
+
+static void _add_octave(
+    float *restrict row, float *restrict lattice, int z, int size,
+    float frequency, float amplitude, uint32_t seed
+) {
+    // hash the two lattice rows around z once, then interpolate every sample
+    int count = (int) ((size - 1) * frequency) + 2;
+    float *gx0 = lattice;
+    float *gz0 = gx0 + count;
+    float *gx1 = gz0 + count;
+    float *gz1 = gx1 + count;
+    float fz = z * frequency;
+    uint32_t iz = (uint32_t) fz;
+    float tz = fz - (float) iz;
+    float wz = _fade(tz);
+    _hash_gradients(gx0, gz0, count, iz, seed);
+    _hash_gradients(gx1, gz1, count, iz + 1, seed);
+    for (int x = 0; x < size; x++) {
+        float fx = x * frequency;
+        int ix = (int) fx;
+        float tx = fx - (float) ix;
+        float wx = _fade(tx);
+        float n00 = gx0[ix] * tx + gz0[ix] * tz;
+        float n10 = gx0[ix + 1] * (tx - 1) + gz0[ix + 1] * tz;
+        float n01 = gx1[ix] * tx + gz1[ix] * (tz - 1);
+        float n11 = gx1[ix + 1] * (tx - 1) + gz1[ix + 1] * (tz - 1);
+        float n0 = n00 + wx * (n10 - n00);
+        float n1 = n01 + wx * (n11 - n01);
+        row[x] += amplitude * (n0 + wz * (n1 - n0));
+    }
+}
+
+static void _generate_rows(int from, int to, void *arg) {
+    const Fbm *fbm = arg;
+    float *row = malloc(fbm->size * sizeof(float));
+    // four lattice rows of gradients, sized for the finest octave
+    float *lattice = malloc((fbm->size + 2) * 4 * sizeof(float));
+    assert_ok(row && lattice, "could not allocate rows");
+    for (int z = from; z < to; z++) {
+        memset(row, 0, fbm->size * sizeof(float));
+        float frequency = fbm->frequency;
+        float amplitude = 1.0f;
+        for (int o = 0; o < fbm->octaves; o++) {
+            _add_octave(
+                row, lattice, z, fbm->size, frequency, amplitude, fbm->seed + o
+            );
+            frequency *= 2.0f;
+            amplitude *= fbm->persistence;
+        }
+        // gradient noise stays well inside +/-0.7, map that onto the range
+        uint16_t *out = &terrain.data[(size_t) z * fbm->size];
+        for (int x = 0; x < fbm->size; x++) {
+            float y = 0.5f + row[x] / fbm->amplitude * 0.7f;
+            y = y < 0 ? 0 : y > 1 ? 1 : y;
+            out[x] = (uint16_t) (y * UINT16_MAX);
+        }
+    }
+    free(row);
+    free(lattice);
+}
+
+void noise_generate(int size, unsigned seed, float roughness) {
+    assert_gt(size, 0, "heightmap size must be positive");
+    uint16_t *data = realloc(
+        terrain.data, (size_t) size * size * sizeof(uint16_t)
+    );
+    assert_ok(data, "could not allocate heightmap");
+    terrain.data = data;
+    terrain.x = terrain.z = size;
+    terrain.y = UINT16_MAX;
+    // a few hills across the map, adding octaves down to single samples
+    Fbm fbm = {size, 1, seed, 4.0f / size, roughness, 1.0f};
+    float cell = size / 4.0f;
+    float amplitude = 1.0f;
+    while (fbm.octaves < _MAX_OCTAVES && cell > 2.0f) {
+        cell /= 2.0f;
+        amplitude *= roughness;
+        fbm.amplitude += amplitude;
+        fbm.octaves++;
+    }
+    jobs_parallel_for(0, size, 4, _generate_rows, &fbm);
+}
@@ -0,0 +1,359 @@
+/**
+ * octree.c
+ *
+ * Sparse octree over the exposed terrain voxels, rebuilt whenever the terrain
+ * changes rather than every frame. The world is cut into cubic cells of
+ * config.octree_leaf voxels, each exposed voxel is bucketed into its cell,
+ * and the non-empty cells become leaves. Internal nodes keep only their
+ * non-empty children, a node left with a single child is replaced by it, and
+ * every node's bounds are tightened to what lies beneath it, so traversal
+ * only ever visits space holding surface.
+ *
+ * Cells are numbered in Morton order, so the voxels under any node are
+ * contiguous and traversal can stop config.octree_depth levels down, treating
+ * the node it stopped at as one big leaf.
+ *
+ * Leaf bounds also cover the LOD patches their voxels sit in, down to the
+ * lowest column in the patch, since a distant leaf draws merged blocks there
+ * instead of its voxels.
+ *
+ * Terrain edits only note the columns they touched. Before the next traversal
+ * the cells over those columns take their voxels afresh from the terrain's
+ * chunks, everything else is copied across in runs, and the nodes are relinked
+ * from the cell counts, so however many chunks were published in between the
+ * tree is brought up to date once.
+ */
+
+#include <string.h>
+#include "debug.h"
+#include "graphics.h"
+
+extern Config config;
+extern Surface surface;
+
+#define _MAX_VOXELS (WORLD_XZ * WORLD_XZ * 2)
+
+static OctreeNode *nodes = NULL;
+static int node_count = 0;
+static int node_capacity = 0;
+static int root = -1;
+static const OctreeNode **visible = NULL;
+static int visible_count = 0;
+static int *cell_start = NULL;
+static int *cell_fresh = NULL;
+static Block *cell_bounds = NULL;
+static int cell_count = 0;
+static int leaf = 0;
+static int levels = 0;
+static Voxel buffers[2][_MAX_VOXELS];
+static Voxel *voxels = buffers[0];
+static Voxel fresh[_MAX_VOXELS];
+static bool stale = true;
+static bool dirty = false;
+static int dirty_x0, dirty_z0, dirty_x1, dirty_z1;
+
+static int _morton(int cx, int cy, int cz) {
+    // interleaved x, y, z bits, in the order children are numbered
+    int key = 0;
+    for (int bit = 0; bit < levels; bit++) {
+        key |= ((cx >> bit) & 1) << (bit * 3);
+        key |= ((cy >> bit) & 1) << (bit * 3 + 1);
+        key |= ((cz >> bit) & 1) << (bit * 3 + 2);
+    }
+    return key;
+}
+
+static int _unmorton(int key, int axis) {
+    int coordinate = 0;
+    for (int bit = 0; bit < levels; bit++)
+        coordinate |= ((key >> (bit * 3 + axis)) & 1) << bit;
+    return coordinate;
+}
+
+static int _round_leaf(int size) {
+    // leaves are whole LOD patches, so every patch falls in one cell column
+    int patch = 1 << (TERRAIN_LOD_LEVELS - 1);
+    int rounded = (size + patch - 1) / patch * patch;
+    return rounded < patch ? patch : rounded;
+}
+
+static void _size_cells() {
+    leaf = _round_leaf(config.octree_leaf);
+    levels = octree_levels(leaf);
+    int cells_xz = (WORLD_XZ + leaf - 1) / leaf;
+    int cells_y = (WORLD_Y + leaf - 1) / leaf;
+    int count = 1 << (levels * 3);
+    if (count != cell_count) {
+        free(cell_start);
+        free(cell_fresh);
+        free(cell_bounds);
+        cell_start = malloc((count + 1) * sizeof(int));
+        cell_fresh = calloc(count + 1, sizeof(int));
+        cell_bounds = malloc(count * sizeof(Block));
+        assert_ok(
+            cell_start && cell_fresh && cell_bounds,
+            "could not allocate octree cells"
+        );
+        cell_count = count;
+    }
+    // each internal node has at least two children
+    int capacity = cells_xz * cells_y * cells_xz * 2;
+    if (capacity > node_capacity) {
+        free(nodes);
+        free(visible);
+        nodes = malloc(capacity * sizeof(OctreeNode));
+        visible = malloc(capacity * sizeof(OctreeNode *));
+        assert_ok(nodes && visible, "could not allocate octree nodes");
+        node_capacity = capacity;
+    }
+}
+
+static void _bucket_voxels() {
+    // counting sort of the exposed voxels by cell
+    memset(cell_start, 0, (cell_count + 1) * sizeof(int));
+    for (int i = 0; i < surface.count; i++) {
+        Voxel v = surface.voxels[i];
+        cell_start[_morton(v.x / leaf, v.y / leaf, v.z / leaf) + 1]++;
+    }
+    for (int c = 0; c < cell_count; c++) cell_start[c + 1] += cell_start[c];
+    for (int i = 0; i < surface.count; i++) {
+        Voxel v = surface.voxels[i];
+        voxels[cell_start[_morton(v.x / leaf, v.y / leaf, v.z / leaf)]++] = v;
+    }
+    // filling moved every start along to the next cell's
+    memmove(&cell_start[1], cell_start, cell_count * sizeof(int));
+    cell_start[0] = 0;
+}
+
+static void _grow(
+    Block *bounds, int x0, int y0, int z0, int x1, int y1, int z1
+) {
+    // union with [x0, x1) x [y0, y1) x [z0, z1), an empty box has no width
+    if (bounds->width) {
+        int bx1 = bounds->x + bounds->width;
+        int by1 = bounds->y + bounds->height;
+        int bz1 = bounds->z + bounds->depth;
+        if (bounds->x < x0) x0 = bounds->x;
+        if (bounds->y < y0) y0 = bounds->y;
+        if (bounds->z < z0) z0 = bounds->z;
+        if (bx1 > x1) x1 = bx1;
+        if (by1 > y1) y1 = by1;
+        if (bz1 > z1) z1 = bz1;
+    }
+    *bounds = (Block) {x0, y0, z0, x1 - x0, y1 - y0, z1 - z0};
+}
+
+static void _bound_cell(int key) {
+    Block *bounds = &cell_bounds[key];
+    int patch = 1 << (TERRAIN_LOD_LEVELS - 1);
+    *bounds = (Block) {0, 0, 0, 0, 0, 0};
+    for (int i = cell_start[key]; i < cell_start[key + 1]; i++) {
+        Voxel v = voxels[i];
+        int px = v.x / patch * patch;
+        int pz = v.z / patch * patch;
+        int bottom = terrain_lod_min(
+            TERRAIN_LOD_LEVELS - 1, v.x / patch, v.z / patch
+        );
+        _grow(
+            bounds,
+            px, bottom < v.y ? bottom : v.y, pz,
+            px + patch < WORLD_XZ ? px + patch : WORLD_XZ, v.y + 1,
+            pz + patch < WORLD_XZ ? pz + patch : WORLD_XZ
+        );
+    }
+}
+
+static OctreeNode _build(int cx, int cy, int cz, int size) {
+    // the subtree over size^3 cells, with no voxels if it holds nothing
+    int key = _morton(cx, cy, cz);
+    int length = size * leaf;
+    OctreeNode node = {
+        {0, 0, 0, 0, 0, 0},
+        {cx * leaf, cy * leaf, cz * leaf, length, length, length},
+        0, 0, cell_start[key],
+        cell_start[key + size * size * size] - cell_start[key]
+    };
+    if (!node.voxel_count) return node;
+    if (size == 1) {
+        node.bounds = cell_bounds[key];
+        return node;
+    }
+    OctreeNode children[8];
+    int count = 0;
+    int half = size / 2;
+    for (int i = 0; i < 8; i++) {
+        children[count] = _build(
+            cx + (i & 1 ? half : 0),
+            cy + (i & 2 ? half : 0),
+            cz + (i & 4 ? half : 0),
+            half
+        );
+        if (children[count].voxel_count) count++;
+    }
+    if (count == 1) return children[0];
+    node.children = node_count;
+    node.child_count = count;
+    for (int i = 0; i < count; i++) {
+        Block *b = &children[i].bounds;
+        _grow(
+            &node.bounds, b->x, b->y, b->z,
+            b->x + b->width, b->y + b->height, b->z + b->depth
+        );
+        nodes[node_count++] = children[i];
+    }
+    return node;
+}
+
+static void _collect(
+    const OctreeNode *node, int depth, bool (*test)(const Block *)
+) {
+    if (!test(&node->bounds)) return;
+    if (!node->child_count || depth == config.octree_depth) {
+        visible[visible_count++] = node;
+        return;
+    }
+    for (int i = 0; i < node->child_count; i++)
+        _collect(&nodes[node->children + i], depth + 1, test);
+}
+
+static void _link() {
+    // nodes from the cell counts and bounds, in the order of the cells
+    node_count = 0;
+    OctreeNode top = _build(0, 0, 0, 1 << levels);
+    root = -1;
+    if (top.voxel_count) {
+        root = node_count;
+        nodes[node_count++] = top;
+    }
+}
+
+static bool _in_columns(int key, int cx0, int cz0, int cx1, int cz1) {
+    int cx = _unmorton(key, 0);
+    int cz = _unmorton(key, 2);
+    return cx >= cx0 && cx < cx1 && cz >= cz0 && cz < cz1;
+}
+
+static void _splice(int x0, int z0, int x1, int z1) {
+    // cells over columns [x0, x1) x [z0, z1) take their voxels afresh from the
+    // terrain's chunks, the rest are copied across as they were
+    int cx0 = x0 / leaf, cz0 = z0 / leaf;
+    int cx1 = (x1 + leaf - 1) / leaf, cz1 = (z1 + leaf - 1) / leaf;
+    int fx0 = cx0 * leaf, fz0 = cz0 * leaf;
+    int fx1 = cx1 * leaf < WORLD_XZ ? cx1 * leaf : WORLD_XZ;
+    int fz1 = cz1 * leaf < WORLD_XZ ? cz1 * leaf : WORLD_XZ;
+    int count = 0;
+    for (int tx = fx0 / TERRAIN_CHUNK_XZ; tx * TERRAIN_CHUNK_XZ < fx1; tx++) {
+        for (int tz = fz0 / TERRAIN_CHUNK_XZ; tz * TERRAIN_CHUNK_XZ < fz1;
+                tz++) {
+            int length;
+            const Voxel *chunk = terrain_chunk_voxels(tx, tz, &length);
+            for (int i = 0; i < length; i++) {
+                Voxel v = chunk[i];
+                if (v.x < fx0 || v.x >= fx1 || v.z < fz0 || v.z >= fz1)
+                    continue;
+                fresh[count++] = v;
+                cell_fresh[_morton(v.x / leaf, v.y / leaf, v.z / leaf)]++;
+            }
+        }
+    }
+    // lay the cells out again, leaving room for the fresh ones
+    Voxel *out = voxels == buffers[0] ? buffers[1] : buffers[0];
+    int total = 0;
+    for (int c = 0; c < cell_count; c++) {
+        int begin = cell_start[c];
+        int end = cell_start[c + 1];
+        cell_start[c] = total;
+        if (_in_columns(c, cx0, cz0, cx1, cz1)) {
+            int fresh_count = cell_fresh[c];
+            cell_fresh[c] = total;
+            total += fresh_count;
+        } else {
+            memcpy(&out[total], &voxels[begin], (end - begin) * sizeof(Voxel));
+            total += end - begin;
+        }
+    }
+    cell_start[cell_count] = total;
+    for (int i = 0; i < count; i++) {
+        Voxel v = fresh[i];
+        out[cell_fresh[_morton(v.x / leaf, v.y / leaf, v.z / leaf)]++] = v;
+    }
+    voxels = out;
+    assert_eq(total, surface.count, "octree out of step with the surface");
+    for (int cx = cx0; cx < cx1; cx++) {
+        for (int cz = cz0; cz < cz1; cz++) {
+            for (int cy = 0; cy < 1 << levels; cy++) {
+                int key = _morton(cx, cy, cz);
+                cell_fresh[key] = 0;
+                _bound_cell(key);
+            }
+        }
+    }
+}
+
+static void _flush() {
+    // bring the tree up to date with the terrain before it is walked
+    if (stale) {
+        octree_rebuild();
+    } else if (dirty) {
+        _splice(dirty_x0, dirty_z0, dirty_x1, dirty_z1);
+        _link();
+        dirty = false;
+        log(
+            "octree refreshed {%d,%d}-{%d,%d} to %d nodes",
+            dirty_x0, dirty_z0, dirty_x1, dirty_z1, node_count
+        );
+    }
+}
+
+int octree_levels(int leaf_size) {
+    // as many as it takes for the cells, once rounded, to cover the world
+    int size = _round_leaf(leaf_size);
+    int cells_xz = (WORLD_XZ + size - 1) / size;
+    int cells_y = (WORLD_Y + size - 1) / size;
+    int count = 0;
+    while (1 << count < cells_xz || 1 << count < cells_y) count++;
+    return count;
+}
+
+const OctreeNode **octree_leaves(bool (*test)(const Block *), int *count) {
+    // nodes passing the test that are leaves or config.octree_depth down
+    _flush();
+    visible_count = 0;
+    if (root >= 0) _collect(&nodes[root], 0, test);
+    *count = visible_count;
+    return visible;
+}
+
+void octree_rebuild() {
+    // linear in the surface rather than the world volume
+    _size_cells();
+    _bucket_voxels();
+    for (int c = 0; c < cell_count; c++) _bound_cell(c);
+    _link();
+    stale = dirty = false;
+    log(
+        "octree rebuilt with %d nodes over %d voxels in %d voxel cells",
+        node_count, surface.count, leaf
+    );
+}
+
+void octree_terrain_changed(int x0, int z0, int x1, int z1) {
+    // loads replace everything, edits are gathered up until the next walk
+    if (x0 <= 0 && z0 <= 0 && x1 >= WORLD_XZ && z1 >= WORLD_XZ) stale = true;
+    if (stale) return;
+    if (!dirty) {
+        dirty_x0 = x0;
+        dirty_z0 = z0;
+        dirty_x1 = x1;
+        dirty_z1 = z1;
+    }
+    dirty = true;
+    if (x0 < dirty_x0) dirty_x0 = x0;
+    if (z0 < dirty_z0) dirty_z0 = z0;
+    if (x1 > dirty_x1) dirty_x1 = x1;
+    if (z1 > dirty_z1) dirty_z1 = z1;
+}
+
+const Voxel *octree_voxels(const OctreeNode *node) {
+    return &voxels[node->voxels];
+}
@@ -1,16 +1,42 @@
-#include <ctype.h>
-#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "debug.h"
+#include "exec.h"
+#include "graphics.h"
 
 #define _PATH_BUFFER 100
 
+typedef struct taps {
+    int *start;
+    int *count;
+    float *weights;
+    int stride;
+} Taps;
+
+typedef struct resample {
+    Taps x;
+    Taps z;
+    float y_scale;
+} Resample;
+
 extern Pgm terrain;
-extern World world_terrain;
+extern SolidMask world_solid;
 
-static char *current_char;
-static char *last_char;
+static const unsigned char *current_char;
+static const unsigned char *last_char;
 static char pgm_path[_PATH_BUFFER] = {'\0'};
+// settle buffers, which belong to the stream loader thread while streaming
+static int order[WORLD_XZ * WORLD_XZ];
+static uint8 sampled[WORLD_XZ][WORLD_XZ];
+static uint8_t settled[WORLD_XZ][WORLD_XZ];
+static const unsigned char *stream_map = NULL;
+static const unsigned char *stream_samples = NULL;
+static size_t stream_length = 0;
 
 bool _check_path(const char *prefix, const char *file_name) {
     snprintf(pgm_path, _PATH_BUFFER, "%s%s", prefix, file_name);
@@ -18,202 +44,280 @@ bool _check_path(const char *prefix, const char *file_name) {
 }
 
 bool _find_file(const char *file_name) {
+    if (_check_path("", file_name)) return true;
     if (_check_path("./", file_name)) return true;
     if (_check_path("./assets/", file_name)) return true;
     if (_check_path("../assets/", file_name)) return true;
     return false;
 }
 
-static char *_load_file(const char *filename) {
-    // open file for reading
+static const unsigned char *_map_file(const char *filename, size_t *length) {
+    // map file read-only, samples are parsed straight out of the page cache
     _find_file(filename);
-    FILE *file_handle = fopen(pgm_path, "rb");
-    if (!file_handle) return NULL;
-    // determine file length
-    fseek(file_handle, 0, SEEK_END);
-    size_t end_position = (size_t) ftell(file_handle);
-    // attempt to read file data into buffer
-    char *buffer = current_char = calloc(end_position, sizeof(char));
-    if (buffer) {
-        fseek(file_handle, 0, SEEK_SET);
-        size_t read_status = fread(buffer, 1, end_position, file_handle);
-        assert_ok(
-            read_status != 0,
-            "could not read pgm data"
-        );
-        last_char = buffer + end_position;
+    int fd = open(pgm_path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    void *map = MAP_FAILED;
+    if (!fstat(fd, &info) && info.st_size > 0) {
+        *length = (size_t) info.st_size;
+        map = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
     }
-    fclose(file_handle);
-    return buffer;
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    madvise(map, *length, MADV_SEQUENTIAL);
+    current_char = map;
+    last_char = current_char + *length;
+    return map;
 }
 
 static bool _is_eof() {
-    return current_char == last_char || *current_char == '\0';
-}
-
-static void _skip_line() {
-    while (!_is_eof() && *(current_char++) != '\n');
+    return current_char == last_char;
 }
 
-static void _skip_comment_line() {
-    while (*current_char == '#') _skip_line();
+static bool _is_space(unsigned char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v'
+        || c == '\f';
 }
 
 static void _skip_whitespace() {
-    while (!_is_eof() && isblank(*current_char)) current_char++;
+    while (!_is_eof()) {
+        if (*current_char == '#') {
+            while (!_is_eof() && *current_char != '\n') current_char++;
+        } else if (_is_space(*current_char)) {
+            current_char++;
+        } else {
+            break;
+        }
+    }
 }
 
-static unsigned _get_next_number(unsigned max) {
-    _skip_comment_line();
+static bool _get_next_number(unsigned max, unsigned *value) {
+    // false when there is no number or it is over max
     _skip_whitespace();
-    char n[PGM_MAX_DIGITS] = {'\0'};
-    char c = '\0';
-    for (int i = 0; i < PGM_MAX_DIGITS; i++) {
-        c = *(current_char++);
-        if (!isdigit(c)) break;
-        n[i] = c;
+    const unsigned char *start = current_char;
+    unsigned long rval = 0;
+    unsigned digit;
+    while (!_is_eof() && (digit = *current_char - (unsigned) '0') < 10) {
+        rval = rval * 10 + digit;
+        if (rval > max) return false;
+        current_char++;
     }
-    long rval = atol(n);
-    assert_ok(c, "no number to parse");
-    assert_ok(!isdigit(c), "parsed value exceeds PGM_MAX_DIGITS");
-    assert_ok(rval >= 0, "value could not be parsed");
-    assert_ok(!max || rval <= max, "parsed value out of range");
-    return (unsigned) rval;
+    *value = (unsigned) rval;
+    return current_char != start;
+}
+
+static bool _get_header(unsigned *x, unsigned *z, unsigned *y) {
+    return _get_next_number(INT_MAX, x) && _get_next_number(INT_MAX, z) &&
+        _get_next_number(UINT16_MAX, y) && *y > 0;
 }
 
-static void _clear_terrain() {
-    // clearout any existing cubes
-    #pragma omp parallel for collapse(3)
-    for (uint8 x = 0; x < WORLD_XZ; x++)
-        for (uint8 y = 0; y < WORLD_Y; y++)
-            for (uint8 z = 0; z < WORLD_XZ; z++)
-                world_terrain[x][y][z] = 0;
+static bool _has_binary_samples(size_t count, unsigned max) {
+    // exactly one whitespace character separates the header from samples
+    size_t width = max < 256 ? 1 : 2;
+    if (_is_eof() || !_is_space(*current_char)) return false;
+    return count <= (size_t) (last_char - current_char - 1) / width;
 }
 
-static void _shuffle(uint8 *a, uint8 n) {
-    static bool first_call = true;
-    if (!first_call) {
-        srand((unsigned) time(NULL));
-        first_call = false;
+static bool _read_ascii_samples(uint16_t *data, size_t count, unsigned max) {
+    for (size_t i = 0; i < count; i++) {
+        unsigned value;
+        if (!_get_next_number(max, &value)) return false;
+        data[i] = (uint16_t) value;
     }
-    for (uint8 i = 0; i < n; i++) a[i] = i;
-    for (uint8 i = 0; i < n - 1; i++) {
-        int j = i + rand() / (RAND_MAX / (n - i) + 1);
-        uint8 t = a[j];
-        a[j] = a[i];
-        a[i] = t;
+    _skip_whitespace();
+    return _is_eof();
+}
+
+static void _read_binary_samples(uint16_t *data, size_t count, unsigned max) {
+    // sizes were checked by _has_binary_samples
+    current_char++;
+    if (max < 256) {
+        for (size_t i = 0; i < count; i++) data[i] = current_char[i];
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            data[i] = (uint16_t)
+                (current_char[2 * i] << 8 | current_char[2 * i + 1]);
+        }
     }
 }
 
-static bool _is_floating_block(uint8 x, uint8 y, uint8 z) {
-    uint8 pts = 0;
-    // block directly below
-    if (world_terrain[x][y - 1][z]) pts += 4;
-    // blocks below
-    if (y - 1 >= 0 && world_terrain[x][y - 1][z]) pts += 3;
-    // blocks underneath and offset
-    if (x - 1 >= 0 && world_terrain[x - 1][y - 1][z]) pts += 4;
-    if (x + 1 < WORLD_XZ && world_terrain[x + 1][y - 1][z]) pts += 4;
-    if (z - 1 >= 0 && world_terrain[x][y - 1][z - 1]) pts += 4;
-    if (z + 1 < WORLD_XZ && world_terrain[x][y - 1][z + 1]) pts += 4;
-    // blocks underneath diagonally
-    if (x - 1 >= 0 && z - 1 >= 0 && world_terrain[x - 1][y - 1][z - 1])
-        pts += 4;
-    if (x - 1 >= 0 && z + 1 < WORLD_XZ && world_terrain[x - 1][y - 1][z + 1])
-        pts += 4;
-    if (x + 1 < WORLD_XZ && z + 1 < WORLD_XZ &&
-        world_terrain[x + 1][y - 1][z + 1])
-        pts += 4;
-    if (x + 1 < WORLD_XZ && z - 1 >= 0 && world_terrain[x + 1][y - 1][z - 1])
-        pts += 4;
-    // blocks adjacent to
-    if ((x - 1 > 0 && world_terrain[x - 1][y][z]) ||
-        (z - 1 > 0 && world_terrain[x][y][z - 1]) ||
-        (z + 1 < WORLD_XZ && world_terrain[x][y][z + 1]) ||
-        (x + 1 < WORLD_XZ && world_terrain[x + 1][y][z]))
-        pts += 2;
-    return pts < 4;
+bool pgm_is_floating_block(uint8 x, uint8 y, uint8 z) {
+    // resting on any of the nine voxels underneath it, directly or
+    // diagonally; the three rows below are merged and tested at once
+    uint64_t below[SOLID_WORDS] = {0};
+    for (int i = x > 0 ? x - 1 : 0; i <= x + 1 && i < WORLD_XZ; i++)
+        for (int w = 0; w < SOLID_WORDS; w++)
+            below[w] |= world_solid[i][y - 1][w];
+    for (int k = z > 0 ? z - 1 : 0; k <= z + 1 && k < WORLD_XZ; k++)
+        if (below[k >> 6] >> (k & 63) & 1) return false;
+    return true;
 }
 
-static void _settle_cubes() {
-    // drop cubes without neighbours to minimize gaps
-    bool retry;
-    uint8 xi[WORLD_XZ], zi[WORLD_XZ];
-    do {
-        retry = false;
-        _shuffle(xi, WORLD_XZ);
-        _shuffle(zi, WORLD_XZ);
-        #pragma omp parallel for
-        for (uint8 x = 0; x < WORLD_XZ; x++) {
-            for (uint8 z = 0; z < WORLD_XZ; z++) {
-                for (uint8 y = WORLD_Y - 1; y > 1; y--) {
-                    x = xi[x];
-                    z = zi[z];
-                    if (world_terrain[x][y][z] == COLOUR_NONE) continue;
-                    if (!_is_floating_block(x, y, z)) continue;
-                    world_terrain[x][y][z] = COLOUR_NONE;
-                    world_terrain[x][y - 1][z] = COLOUR_BLACK;
-                    retry = true;
-                }
+static void _settle_level(int from, int to, void *arg) {
+    // drop columns until they rest diagonally or directly on a lower one
+    for (int i = from; i < to; i++) {
+        int x = order[i] / WORLD_XZ;
+        int z = order[i] % WORLD_XZ;
+        uint8 height = sampled[x][z];
+        uint8 y = height <= 1 ? height : 1;
+        for (int nx = x - 1; height > 1 && nx <= x + 1; nx++) {
+            for (int nz = z - 1; nz <= z + 1; nz++) {
+                if (nx < 0 || nz < 0 || nx >= WORLD_XZ || nz >= WORLD_XZ)
+                    continue;
+                // only lower columns have settled, and they never move again
+                if (sampled[nx][nz] >= height) continue;
+                if (settled[nx][nz] + 1 > y) y = settled[nx][nz] + 1;
             }
         }
-    } while (retry);
+        settled[x][z] = y;
+    }
 }
 
-static void _add_base_layer() {
-    // add plane of cubes along bottom border
-    #pragma omp parallel for collapse(2)
+static void _settle_cubes(bool parallel) {
+    // bucket columns by height so each level only depends on lower ones
+    int level_start[WORLD_Y + 1] = {0};
+    for (int x = 0; x < WORLD_XZ; x++)
+        for (int z = 0; z < WORLD_XZ; z++)
+            level_start[sampled[x][z] + 1]++;
+    for (int y = 0; y < WORLD_Y; y++) level_start[y + 1] += level_start[y];
+    int fill[WORLD_Y];
+    memcpy(fill, level_start, sizeof(fill));
     for (int x = 0; x < WORLD_XZ; x++)
         for (int z = 0; z < WORLD_XZ; z++)
-            if (!world_terrain[x][1][z])
-                world_terrain[x][0][z] = COLOUR_BLACK;
+            order[fill[sampled[x][z]]++] = x * WORLD_XZ + z;
+    for (int y = 0; y < WORLD_Y; y++) {
+        if (!parallel) {
+            _settle_level(level_start[y], level_start[y + 1], NULL);
+            continue;
+        }
+        jobs_parallel_for(
+            level_start[y], level_start[y + 1], 256, _settle_level, NULL
+        );
+    }
 }
 
-static void _cull_overlapping_cubes() {
-    // limit 1 cube to x/z coordinate
-    bool ceil;
-    #pragma omp parallel for collapse(2)
-    for (int x = 0; x < WORLD_XZ; x++) {
-        for (int z = 0; z < WORLD_XZ; z++) {
-            ceil = false;
-            for (int y = WORLD_Y - 1; y >= 0; y--) {
-                if (world_terrain[x][y][z] != COLOUR_BLACK)
-                    continue;
-                else if (!ceil)
-                    ceil = true;
-                else
-                    world_terrain[x][y][z] = COLOUR_NONE;
-            }
-        }
+static bool _fail(const unsigned char *map, size_t length, const char *why) {
+    log_error("could not load pgm file: %s", why);
+    munmap((void *) map, length);
+    return false;
+}
+
+bool pgm_init(const char *filename) {
+    // parsed aside and only swapped in whole, so a bad file changes nothing
+    size_t length = 0;
+    const unsigned char *map = _map_file(filename, &length);
+    if (!map) {
+        log_error("no data loaded from %s", filename);
+        return false;
     }
+    // parse header
+    if (length <= 2 || map[0] != 'P') return _fail(map, length, "not a pgm");
+    bool binary = map[1] == '5';
+    if (!binary && map[1] != '2')
+        return _fail(map, length, "only P2 and P5 are supported");
+    current_char += 2;
+    unsigned x, z, y;
+    if (!_get_header(&x, &z, &y)) return _fail(map, length, "bad header");
+    if (!x || !z) return _fail(map, length, "no samples");
+    if (z > SIZE_MAX / sizeof(uint16_t) / x)
+        return _fail(map, length, "dimensions too large");
+    size_t count = (size_t) x * z;
+    if (binary && !_has_binary_samples(count, y))
+        return _fail(map, length, "not enough samples");
+    // parse data, sizing the sample buffer to the map
+    uint16_t *data = malloc(count * sizeof(uint16_t));
+    if (!data) return _fail(map, length, "out of memory for samples");
+    if (binary) {
+        _read_binary_samples(data, count, y);
+    } else if (!_read_ascii_samples(data, count, y)) {
+        free(data);
+        return _fail(map, length, "bad samples");
+    }
+    munmap((void *) map, length);
+    free(terrain.data);
+    terrain.data = data;
+    terrain.z = (int) z;
+    terrain.x = (int) x;
+    terrain.y = (int) y;
+    return true;
 }
 
-void pgm_init(const char *filename) {
-    // load file
-    char *buffer = _load_file(filename);
-    assert_ok(buffer, "no data loaded from file");
-    // parse dimensions
-    _skip_line();
-    unsigned x = _get_next_number(0);
-    unsigned z = _get_next_number(0);
-    unsigned y = _get_next_number(0);
-    // initialize
-    terrain.z = z;
+uint64_t pgm_hash(const char *filename) {
+    // FNV-1a over the raw file
+    size_t length = 0;
+    const unsigned char *map = _map_file(filename, &length);
+    if (!map) return 0;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= map[i];
+        hash *= 1099511628211ULL;
+    }
+    munmap((void *) map, length);
+    return hash;
+}
+
+void pgm_settle_heights(uint8_t heights[WORLD_XZ][WORLD_XZ]) {
+    // serial, as the stream loader calls it off the pool: jobs it pushed would
+    // land on the main thread's deque and be run mid-frame
+    for (int x = 0; x < WORLD_XZ; x++)
+        for (int z = 0; z < WORLD_XZ; z++)
+            sampled[x][z] = heights[x][z];
+    _settle_cubes(false);
+    memcpy(heights, settled, sizeof(settled));
+}
+
+void pgm_stream_close() {
+    if (stream_map) munmap((void *) stream_map, stream_length);
+    stream_map = stream_samples = NULL;
+    stream_length = 0;
+}
+
+bool pgm_stream_open(const char *filename) {
+    // keep a binary map mapped so tiles can be sampled on demand, leaving the
+    // page cache to decide what is actually resident
+    size_t length = 0;
+    const unsigned char *map = _map_file(filename, &length);
+    if (!map) return false;
+    if (length < 3 || map[0] != 'P' || map[1] != '5') {
+        log_warn("streaming needs a binary (P5) pgm file");
+        munmap((void *) map, length);
+        return false;
+    }
+    current_char += 2;
+    unsigned x, z, y;
+    if (!_get_header(&x, &z, &y) || !x || !z ||
+        !_has_binary_samples((size_t) x * z, y)) {
+        log_warn("not enough samples in file");
+        munmap((void *) map, length);
+        return false;
+    }
+    current_char++;
+    madvise((void *) map, length, MADV_RANDOM);
+    pgm_stream_close();
+    stream_map = map;
+    stream_samples = current_char;
+    stream_length = length;
     terrain.x = x;
     terrain.y = y;
-    // parse data
-    unsigned datum_counter = 0;
-    do {
-        terrain.data[datum_counter++] = _get_next_number(y);
-    } while (datum_counter < z * x);
-    // verify eof
-    _skip_whitespace();
-    assert_ok(_is_eof(), "unexpected data at end of file");
-    free(buffer);
+    terrain.z = z;
+    return true;
+}
+
+unsigned pgm_stream_sample(int x, int z) {
+    // clamped, so tiles overhanging the map repeat its edge
+    x = x < 0 ? 0 : x >= terrain.x ? terrain.x - 1 : x;
+    z = z < 0 ? 0 : z >= terrain.z ? terrain.z - 1 : z;
+    size_t i = (size_t) z * terrain.x + x;
+    if (terrain.y < 256) return stream_samples[i];
+    return (unsigned) (stream_samples[2 * i] << 8 | stream_samples[2 * i + 1]);
+}
+
+const char *pgm_find(const char *filename) {
+    return _find_file(filename) ? pgm_path : NULL;
 }
 
 unsigned pgm_get_y_value(double x, double z) {
-    int i = (int) (z * terrain.z + x);
+    int i = (int) z * terrain.x + (int) x;
     assert_lt(x, terrain.x, "x value out of range");
     assert_lt(z, terrain.z, "z value out of range");
     assert_lt(i, terrain.x * terrain.z, "index out of range");
@@ -221,44 +325,134 @@ unsigned pgm_get_y_value(double x, double z) {
 }
 
 unsigned pgm_calc_ceil() {
-    float ceil = 0;
-    for (int i = 0; i < terrain.x * terrain.z; i++) {
-        if (terrain.data[i] > ceil) {
-            ceil = terrain.data[i];
-        }
-    }
-    ceil += ceil * 0.1f;
+    // integer max so the scan vectorizes
+    size_t count = (size_t) terrain.x * terrain.z;
+    uint16_t high = 0;
+    for (size_t i = 0; i < count; i++)
+        high = terrain.data[i] > high ? terrain.data[i] : high;
+    float ceil = high + high * 0.1f;
     assert_gte(ceil, 0.0f, "ceil underflow imminent");
     return (unsigned) ceil;
 }
 
+static void _build_taps(Taps *taps, int source, int target) {
+    // per output cell: the run of source samples it reads and their weights
+    double step = (double) source / target;
+    taps->stride = source > target ? (int) ceil(step) + 1 : 2;
+    taps->start = malloc(target * sizeof(int));
+    taps->count = malloc(target * sizeof(int));
+    taps->weights = calloc((size_t) target * taps->stride, sizeof(float));
+    assert_ok(
+        taps->start && taps->count && taps->weights, "could not allocate taps"
+    );
+    for (int i = 0; i < target; i++) {
+        float *weights = &taps->weights[i * taps->stride];
+        if (source > target) {
+            // box filter over the source area the cell covers
+            double from = i * step;
+            double to = from + step;
+            int first = (int) from;
+            int last = (int) ceil(to) < source ? (int) ceil(to) : source;
+            taps->start[i] = first;
+            taps->count[i] = last - first;
+            for (int j = first; j < last; j++) {
+                double lo = j > from ? j : from;
+                double hi = j + 1 < to ? j + 1 : to;
+                weights[j - first] = (float) ((hi - lo) / step);
+            }
+        } else {
+            // bilinear, with the corners of source and target aligned
+            double position = target > 1
+                ? i * (source - 1.0) / (target - 1.0) : 0;
+            int first = (int) position;
+            if (first > source - 2) first = source > 1 ? source - 2 : 0;
+            float t = (float) (position - first);
+            taps->start[i] = first;
+            taps->count[i] = source > 1 ? 2 : 1;
+            weights[0] = source > 1 ? 1.0f - t : 1.0f;
+            weights[1] = t;
+        }
+    }
+}
+
+static void _free_taps(Taps *taps) {
+    free(taps->start);
+    free(taps->count);
+    free(taps->weights);
+}
+
+static void _accumulate_row(
+    float *restrict row, const uint16_t *restrict samples, int count,
+    float weight
+) {
+    int i = 0;
+#ifdef __GNUC__
+    // eight lanes at a time, leaving the compiler to pick the instructions
+    typedef float Floats __attribute__((vector_size(32)));
+    typedef uint16_t Shorts __attribute__((vector_size(16)));
+    Floats weights = {
+        weight, weight, weight, weight, weight, weight, weight, weight
+    };
+    for (; i + 8 <= count; i += 8) {
+        Shorts in;
+        Floats out;
+        memcpy(&in, samples + i, sizeof(in));
+        memcpy(&out, row + i, sizeof(out));
+        out += __builtin_convertvector(in, Floats) * weights;
+        memcpy(row + i, &out, sizeof(out));
+    }
+#endif
+    for (; i < count; i++) row[i] += samples[i] * weight;
+}
+
+static void _resample_rows(int from, int to, void *arg) {
+    // vertical pass blends whole source rows, then the horizontal pass
+    // reduces the blended row to the world's width
+    const Resample *resample = arg;
+    float *row = malloc(terrain.x * sizeof(float));
+    assert_ok(row, "could not allocate row");
+    for (int z = from; z < to; z++) {
+        memset(row, 0, terrain.x * sizeof(float));
+        const Taps *taps = &resample->z;
+        const float *weights = &taps->weights[z * taps->stride];
+        for (int j = 0; j < taps->count[z]; j++) {
+            const uint16_t *samples =
+                &terrain.data[(size_t) (taps->start[z] + j) * terrain.x];
+            _accumulate_row(row, samples, terrain.x, weights[j]);
+        }
+        taps = &resample->x;
+        for (int x = 0; x < WORLD_XZ; x++) {
+            weights = &taps->weights[x * taps->stride];
+            const float *span = &row[taps->start[x]];
+            float sum = 0;
+            for (int j = 0; j < taps->count[x]; j++) sum += span[j] * weights[j];
+            float y = sum / resample->y_scale;
+            sampled[x][z] = (uint8) (y < WORLD_Y - 1 ? y : WORLD_Y - 1);
+        }
+    }
+    free(row);
+}
+
 void pgm_set_world_terrain() {
-    _clear_terrain();
     unsigned y_max = pgm_calc_ceil();
-    double x_scale = (terrain.x - 1) / (WORLD_XZ - 1.0);
-    double y_scale = (y_max - 1) / (WORLD_Y - 1.0);
-    double z_scale = (terrain.z - 1) / (WORLD_XZ - 1.0);
-    double sx, sy, sz;
-    uint8 y;
-    // nearest neighbour interpolation
-    #pragma omp parallel for
-    for (uint8 x = 0; x < WORLD_XZ; x++) {
-        for (uint8 z = 0; z < WORLD_XZ; z++) {
-            sx = x * x_scale;
-            assert_gte(sx, 0.0f, "sx value out of range");
-            assert_lt(sx, terrain.x, "sx value out of range");
-            sz = z * z_scale;
-            assert_gte(sz, 0.0f, "sz value out of range");
-            assert_lt(sz, terrain.z, "sz value out of range");
-            sy = pgm_get_y_value(sx, sz) / y_scale;
-            assert_gte(sy, 0.0f, "sy value out of range");
-            assert_lt(sy, WORLD_Y, "sy value out of range");
-            y = (uint8) sy;
-            world_terrain[x][y][z] = COLOUR_BLACK;
+    Resample resample;
+    resample.y_scale = (y_max - 1) / (WORLD_Y - 1.0f);
+    _build_taps(&resample.x, terrain.x, WORLD_XZ);
+    _build_taps(&resample.z, terrain.z, WORLD_XZ);
+    jobs_parallel_for(0, WORLD_XZ, 4, _resample_rows, &resample);
+    _free_taps(&resample.x);
+    _free_taps(&resample.z);
+    // normalize units
+    _settle_cubes(true);
+    terrain_set_heights(settled);
+#ifndef NDEBUG
+    for (int x = 0; x < WORLD_XZ; x++) {
+        for (int z = 0; z < WORLD_XZ; z++) {
+            uint8 y = settled[x][z];
+            assert_not(
+                y > 1 && pgm_is_floating_block(x, y, z), "cube left floating"
+            );
         }
     }
-    // normalize units
-    _settle_cubes();
-    _cull_overlapping_cubes();
-    _add_base_layer();
+#endif
 }
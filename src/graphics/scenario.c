@@ -0,0 +1,175 @@
+/**
+ * scenario.c
+ *
+ * Scripted camera flythroughs for repeatable rendering workloads. A scenario
+ * is a text file of timed commands, one per line, with '#' comments:
+ *
+ *     key <ms> <x> <y> <z> <pitch> <yaw>    camera keyframe in world space
+ *     overhead <ms> <0|1>                   oblique overhead view
+ *     drawall <ms> <0|1>                    draw every surface voxel
+ *     map <ms> <hidden|mini|full>           minimap mode
+ *
+ * Commands must be in time order. The camera is interpolated linearly between
+ * keyframes and toggles fire once playback reaches their time. Rewinding puts
+ * the toggled settings back as they were when the scenario was loaded.
+ */
+
+#include <string.h>
+#include "debug.h"
+#include "graphics.h"
+
+#define _LINE_BUFFER 160
+
+typedef enum action {
+    ACTION_DRAWALL = 0,
+    ACTION_MAP,
+    ACTION_OVERHEAD,
+} Action;
+
+typedef struct keyframe {
+    double ms;
+    float x;
+    float y;
+    float z;
+    float pitch;
+    float yaw;
+} Keyframe;
+
+typedef struct toggle {
+    double ms;
+    Action action;
+    int value;
+} Toggle;
+
+extern Config config;
+extern Position player_pos;
+extern View view;
+
+static Keyframe keys[SCENARIO_STEPS_MAX];
+static int key_count = 0;
+static Toggle toggles[SCENARIO_STEPS_MAX];
+static int toggle_count = 0;
+static int toggle_next = 0;
+static bool start_display_all_cubes = false;
+static bool start_overhead_view = false;
+static MapMode start_map_mode = MAP_MINI;
+
+static bool _parse_toggle(const char *command, const char *line, Toggle *t) {
+    char value[16];
+    if (sscanf(line, "%*s %lf %15s", &t->ms, value) != 2) return false;
+    if (!strcmp(command, "map")) {
+        t->action = ACTION_MAP;
+        if (!strcmp(value, "hidden")) t->value = MAP_HIDDEN;
+        else if (!strcmp(value, "mini")) t->value = MAP_MINI;
+        else if (!strcmp(value, "full")) t->value = MAP_FULL;
+        else return false;
+        return true;
+    }
+    if (!strcmp(command, "overhead")) t->action = ACTION_OVERHEAD;
+    else if (!strcmp(command, "drawall")) t->action = ACTION_DRAWALL;
+    else return false;
+    t->value = atoi(value) != 0;
+    return true;
+}
+
+static bool _parse_line(const char *line) {
+    char command[16];
+    if (sscanf(line, "%15s", command) != 1 || command[0] == '#') return true;
+    if (!strcmp(command, "key")) {
+        if (key_count == SCENARIO_STEPS_MAX) return false;
+        Keyframe *k = &keys[key_count];
+        if (sscanf(
+                line, "%*s %lf %f %f %f %f %f",
+                &k->ms, &k->x, &k->y, &k->z, &k->pitch, &k->yaw
+            ) != 6) return false;
+        if (key_count && k->ms < keys[key_count - 1].ms) return false;
+        key_count++;
+        return true;
+    }
+    if (toggle_count == SCENARIO_STEPS_MAX) return false;
+    Toggle *t = &toggles[toggle_count];
+    if (!_parse_toggle(command, line, t)) return false;
+    if (toggle_count && t->ms < toggles[toggle_count - 1].ms) return false;
+    toggle_count++;
+    return true;
+}
+
+static void _fire(Toggle *t) {
+    switch (t->action) {
+        case ACTION_DRAWALL:
+            config.display_all_cubes = t->value;
+            break;
+        case ACTION_MAP:
+            config.map_mode = t->value;
+            map_pos_update();
+            break;
+        case ACTION_OVERHEAD:
+            config.overhead_view = t->value;
+            break;
+    }
+}
+
+bool scenario_load(const char *filename) {
+    const char *path = pgm_find(filename);
+    FILE *file = path ? fopen(path, "r") : NULL;
+    if (!file) {
+        log_error("could not open scenario %s", filename);
+        return false;
+    }
+    key_count = toggle_count = 0;
+    char line[_LINE_BUFFER];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        if (!_parse_line(line))
+            log_warn("%s:%d: skipping bad scenario line", filename, number);
+    }
+    fclose(file);
+    if (!key_count) {
+        log_error("scenario %s has no keyframes", filename);
+        return false;
+    }
+    start_display_all_cubes = config.display_all_cubes;
+    start_overhead_view = config.overhead_view;
+    start_map_mode = config.map_mode;
+    scenario_rewind();
+    log_info(
+        "scenario %s: %d keyframes, %d toggles, %.0f ms",
+        filename, key_count, toggle_count, scenario_length()
+    );
+    return true;
+}
+
+double scenario_length() {
+    double length = keys[key_count - 1].ms;
+    if (toggle_count && toggles[toggle_count - 1].ms > length)
+        length = toggles[toggle_count - 1].ms;
+    return length;
+}
+
+void scenario_rewind() {
+    toggle_next = 0;
+    config.display_all_cubes = start_display_all_cubes;
+    config.overhead_view = start_overhead_view;
+    if (config.map_mode != start_map_mode) {
+        config.map_mode = start_map_mode;
+        map_pos_update();
+    }
+}
+
+bool scenario_apply(double ms) {
+    while (toggle_next < toggle_count && toggles[toggle_next].ms <= ms)
+        _fire(&toggles[toggle_next++]);
+    // find the keyframes either side and blend between them
+    int next = 0;
+    while (next < key_count && keys[next].ms <= ms) next++;
+    Keyframe from = keys[next ? next - 1 : 0];
+    Keyframe to = keys[next < key_count ? next : key_count - 1];
+    float t = 0;
+    if (to.ms > from.ms && ms > from.ms)
+        t = (float) ((ms - from.ms) / (to.ms - from.ms));
+    player_pos.x = -(from.x + (to.x - from.x) * t);
+    player_pos.y = -(from.y + (to.y - from.y) * t);
+    player_pos.z = -(from.z + (to.z - from.z) * t);
+    view.cam_x = (int) (from.pitch + (to.pitch - from.pitch) * t);
+    view.cam_y = (int) (from.yaw + (to.yaw - from.yaw) * t);
+    return ms <= scenario_length();
+}
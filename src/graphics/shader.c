@@ -0,0 +1,330 @@
+/**
+ * shader.c
+ *
+ * Programmable pipeline backend. Terrain blocks, units and the skybox are all
+ * unit cubes, so each frame they're gathered into one buffer of instances and
+ * drawn with a single instanced call. The shaders read the light, fog and
+ * matrix state the fixed function path sets up, so either display hook can be
+ * swapped in without touching the rest of the engine. Lasers and the 2d
+ * overlay are left to the fixed function code.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+#include <string.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+#include "world.h"
+
+#define _PALETTE_SIZE (COLOUR_YELLOW + 1)
+#define _SOURCE_BUFFER 4096
+
+typedef struct instance {
+    GLfloat offset[3];
+    GLfloat size[3];
+    GLfloat colour;
+} Instance;
+
+extern Config config;
+extern GlutHooks glut_hooks;
+extern Position player_pos;
+extern View view;
+extern World world_units;
+
+#ifndef __APPLE__
+
+// lit per vertex like the fixed function pipeline: shininess 0, local viewer;
+// terrain takes the same sun shading as the baked colours, less occlusion
+static const char *vertex_source =
+    "attribute vec3 position;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec3 offset;\n"
+    "attribute vec3 size;\n"
+    "attribute float colour;\n"
+    "uniform vec4 palette[PALETTE_SIZE];\n"
+    "varying vec4 tint;\n"
+    "varying float depth;\n"
+    "vec4 light(int i, vec3 eye, vec3 n, vec4 amb, vec4 dif, vec4 spec) {\n"
+    "    vec4 p = gl_LightSource[i].position;\n"
+    "    vec3 l = p.w == 0.0 ? normalize(p.xyz) : normalize(p.xyz - eye);\n"
+    "    float d = p.w == 0.0 ? 0.0 : length(p.xyz - eye);\n"
+    "    float att = p.w == 0.0 ? 1.0 : 1.0 / (\n"
+    "        gl_LightSource[i].constantAttenuation +\n"
+    "        gl_LightSource[i].linearAttenuation * d +\n"
+    "        gl_LightSource[i].quadraticAttenuation * d * d);\n"
+    "    float lambert = max(dot(n, l), 0.0);\n"
+    "    vec4 c = gl_LightSource[i].ambient * amb +\n"
+    "        gl_LightSource[i].diffuse * dif * lambert;\n"
+    "    if (lambert > 0.0) c += gl_LightSource[i].specular * spec;\n"
+    "    return c * att;\n"
+    "}\n"
+    "void main() {\n"
+    "    vec4 eye = gl_ModelViewMatrix * vec4(offset + position * size, 1);\n"
+    "    vec3 n = normalize(gl_NormalMatrix * normal);\n"
+    "    int index = int(colour);\n"
+    "    vec4 amb = palette[index];\n"
+    "    vec4 dif = palette[index];\n"
+    "    vec4 spec = palette[WHITE];\n"
+    "    vec4 emit = vec4(0);\n"
+    "    if (index == SKY) {\n"
+    "        amb = dif = palette[TERRAIN];\n"
+    "        emit = palette[GREY3];\n"
+    "    }\n"
+    "    tint = emit + gl_LightModel.ambient * amb +\n"
+    "        light(0, eye.xyz, n, amb, dif, spec) +\n"
+    "        light(1, eye.xyz, n, amb, dif, spec);\n"
+    "    tint.a = dif.a;\n"
+    "    if (index == TERRAIN) {\n"
+    "        float lambert = max(dot(normal, normalize(SUN)), 0.0);\n"
+    "        tint = vec4(vec3(AMBIENT + SUN_LEVEL * lambert), 1);\n"
+    "    }\n"
+    "    depth = abs(eye.z);\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+
+static const char *fragment_source =
+    "uniform bool fog;\n"
+    "varying vec4 tint;\n"
+    "varying float depth;\n"
+    "void main() {\n"
+    "    vec4 c = tint;\n"
+    "    if (fog) {\n"
+    "        float f = clamp((gl_Fog.end - depth) * gl_Fog.scale, 0.0, 1.0);\n"
+    "        c.rgb = mix(gl_Fog.color.rgb, c.rgb, f);\n"
+    "    }\n"
+    "    gl_FragColor = c;\n"
+    "}\n";
+
+static const char *attribute_names[] = {
+    "position", "normal", "offset", "size", "colour"
+};
+
+static GLuint program = 0;
+static GLuint cube_buffer = 0;
+static GLuint instance_buffer = 0;
+static GLint attributes[5];
+static GLint fog_uniform;
+static Instance *instances = NULL;
+static int instance_count = 0;
+static int instance_capacity = 0;
+
+static GLuint _compile(GLenum type, const char *body) {
+    // shared defines keep the shaders' palette indices in step with Colour
+    char source[_SOURCE_BUFFER];
+    const float *sun = lighting_sun();
+    int length = snprintf(
+        source, sizeof(source),
+        "#version 120\n#define PALETTE_SIZE %d\n#define SKY %d\n"
+        "#define TERRAIN %d\n#define GREY3 %d\n#define WHITE %d\n"
+        "#define AMBIENT %f\n#define SUN_LEVEL %f\n"
+        "#define SUN vec3(%f, %f, %f)\n%s",
+        _PALETTE_SIZE, COLOUR_NONE, COLOUR_BLACK, COLOUR_GREY3, COLOUR_WHITE,
+        LIGHT_AMBIENT, LIGHT_SUN, sun[0], sun[1], sun[2], body
+    );
+    if (length < 0 || length >= _SOURCE_BUFFER) {
+        log_error("shader source too long");
+        return 0;
+    }
+    const char *sources[1] = {source};
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, sources, NULL);
+    glCompileShader(shader);
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char info[LOG_MESSAGE_SIZE];
+        glGetShaderInfoLog(shader, sizeof(info), NULL, info);
+        log_warn("shader failed to compile: %s", info);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static void _build_cube() {
+    // unit cube from the origin, two triangles a face, position then normal
+    GLfloat vertices[36][6];
+    static const int quad[6] = {0, 1, 2, 0, 2, 3};
+    static const int corner[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    for (int face = 0; face < 6; face++) {
+        int axis = face / 2;
+        int side = face % 2 ? 0 : 1;
+        for (int i = 0; i < 6; i++) {
+            GLfloat *vertex = vertices[face * 6 + i];
+            vertex[axis] = side;
+            vertex[(axis + 1) % 3] = corner[quad[i]][0];
+            vertex[(axis + 2) % 3] = corner[quad[i]][1];
+            vertex[3] = vertex[4] = vertex[5] = 0;
+            vertex[3 + axis] = side ? 1 : -1;
+        }
+    }
+    glGenBuffers(1, &cube_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, cube_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void _add_instance(
+    float x, float y, float z, float width, float height, float depth,
+    Colour colour
+) {
+    if (instance_count == instance_capacity) {
+        int capacity = instance_capacity ? instance_capacity * 2 : 4096;
+        Instance *grown = realloc(instances, capacity * sizeof(Instance));
+        assert_ok(grown, "could not grow instance buffer");
+        instances = grown;
+        instance_capacity = capacity;
+    }
+    instances[instance_count++] = (Instance) {
+        {x, y, z}, {width, height, depth}, (GLfloat) colour
+    };
+}
+
+static void _gather() {
+    // terrain front to back, then units, then the skybox centred on the
+    // player where depth testing can reject most of it
+    float reach = (float) config.draw_distance;
+    instance_count = 0;
+    build_display_list();
+    Block *blocks = get_display_list();
+    for (int i = 0; i < view.count; i++) {
+        _add_instance(
+            blocks[i].x, blocks[i].y, blocks[i].z,
+            blocks[i].width, blocks[i].height, blocks[i].depth,
+            COLOUR_BLACK
+        );
+    }
+    for (int x = 0; x < WORLD_XZ; x++)
+        for (int y = 0; y < WORLD_Y; y++)
+            for (int z = 0; z < WORLD_XZ; z++)
+                if (world_at(world_units, x, y, z))
+                    _add_instance(
+                        x, y, z, 1, 1, 1, world_at(world_units, x, y, z)
+                    );
+    _add_instance(
+        -player_pos.x - reach, -player_pos.y - reach, -player_pos.z - reach,
+        reach * 2, reach * 2, reach * 2, COLOUR_NONE
+    );
+}
+
+static void _draw_instances() {
+    glUseProgram(program);
+    glUniform1i(fog_uniform, config.fog);
+    glBindBuffer(GL_ARRAY_BUFFER, cube_buffer);
+    GLsizei stride = 6 * sizeof(GLfloat);
+    glVertexAttribPointer(attributes[0], 3, GL_FLOAT, GL_FALSE, stride, 0);
+    glVertexAttribPointer(
+        attributes[1], 3, GL_FLOAT, GL_FALSE, stride,
+        (void *) (3 * sizeof(GLfloat))
+    );
+    // orphan last frame's instances rather than wait on them
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(
+        GL_ARRAY_BUFFER, instance_capacity * sizeof(Instance), NULL,
+        GL_STREAM_DRAW
+    );
+    glBufferSubData(
+        GL_ARRAY_BUFFER, 0, instance_count * sizeof(Instance), instances
+    );
+    stride = sizeof(Instance);
+    glVertexAttribPointer(
+        attributes[2], 3, GL_FLOAT, GL_FALSE, stride,
+        (void *) offsetof(Instance, offset)
+    );
+    glVertexAttribPointer(
+        attributes[3], 3, GL_FLOAT, GL_FALSE, stride,
+        (void *) offsetof(Instance, size)
+    );
+    glVertexAttribPointer(
+        attributes[4], 1, GL_FLOAT, GL_FALSE, stride,
+        (void *) offsetof(Instance, colour)
+    );
+    for (int i = 0; i < 5; i++) {
+        glEnableVertexAttribArray(attributes[i]);
+        glVertexAttribDivisor(attributes[i], i < 2 ? 0 : 1);
+    }
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instance_count);
+    for (int i = 0; i < 5; i++) {
+        glVertexAttribDivisor(attributes[i], 0);
+        glDisableVertexAttribArray(attributes[i]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
+
+bool shader_init() {
+    // instanced attributes need 3.3, which llvmpipe provides
+    int major = 0;
+    int minor = 0;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    if (!version || sscanf(version, "%d.%d", &major, &minor) != 2 ||
+        major * 10 + minor < 33) {
+        log_warn("shader renderer needs OpenGL 3.3, using fixed function");
+        return false;
+    }
+    GLuint vertex = _compile(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment = _compile(GL_FRAGMENT_SHADER, fragment_source);
+    if (!vertex || !fragment) return false;
+    program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char info[LOG_MESSAGE_SIZE];
+        glGetProgramInfoLog(program, sizeof(info), NULL, info);
+        log_warn("shader failed to link: %s", info);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+    for (int i = 0; i < 5; i++)
+        attributes[i] = glGetAttribLocation(program, attribute_names[i]);
+    fog_uniform = glGetUniformLocation(program, "fog");
+    GLfloat palette[_PALETTE_SIZE][4];
+    for (int i = 0; i < _PALETTE_SIZE; i++)
+        memcpy(palette[i], *get_material(i), sizeof(palette[i]));
+    glUseProgram(program);
+    glUniform4fv(
+        glGetUniformLocation(program, "palette"), _PALETTE_SIZE, *palette
+    );
+    glUseProgram(0);
+    _build_cube();
+    glGenBuffers(1, &instance_buffer);
+    log_info("shader renderer on %s", (const char *) glGetString(GL_RENDERER));
+    return true;
+}
+
+#else
+
+static void _gather() {}
+static void _draw_instances() {}
+
+bool shader_init() {
+    log_warn("shader renderer unavailable on macOS, using fixed function");
+    return false;
+}
+
+#endif
+
+void glut_hook_shader__display() {
+    double start = profile_now();
+    view.count = 0;
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    place_camera();
+    _gather();
+    _draw_instances();
+    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, *get_material(COLOUR_BLACK));
+    if (config.fog) glEnable(GL_FOG);
+    shoot_laser();
+    glDisable(GL_FOG);
+    draw_overlay();
+    glut_hooks.swap_buffers();
+    double ms = profile_now() - start;
+    profile_frame(ms);
+    tuner_frame(ms);
+}
@@ -0,0 +1,235 @@
+/**
+ * stream.c
+ *
+ * Streams maps larger than the world one window at a time. The map is kept
+ * memory-mapped and sampled one pixel per column into TILE_XZ square tiles,
+ * which are cached least-recently-used under config.stream_budget. When the
+ * player nears an edge, a loader thread assembles and settles the next window
+ * from tiles; the main thread then swaps it in and shifts everything in the
+ * world by the same offset.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+
+#define _WINDOW_TILES (WORLD_XZ / TILE_XZ)
+#define _RING_TILES (_WINDOW_TILES + 2)
+
+typedef struct tile {
+    int x;
+    int z;
+    long used;
+    uint8_t heights[TILE_XZ][TILE_XZ];
+} Tile;
+
+extern Config config;
+extern Laser player_laser;
+extern Pgm terrain;
+extern Position player_pos;
+
+static Tile *tiles = NULL;
+static int tile_count = 0;
+static int tile_capacity = 0;
+static long generation = 0;
+static double y_scale = 1;
+static pthread_t loader;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static bool running = false;
+static bool requested = false;
+static bool ready = false;
+static int request_x, request_z;
+static int window_x, window_z;
+static uint8_t pending[WORLD_XZ][WORLD_XZ];
+
+static void _sample_tile(Tile *tile) {
+    for (int x = 0; x < TILE_XZ; x++) {
+        for (int z = 0; z < TILE_XZ; z++) {
+            double y = pgm_stream_sample(
+                tile->x * TILE_XZ + x, tile->z * TILE_XZ + z
+            ) / y_scale;
+            tile->heights[x][z] = (uint8_t) (y < WORLD_Y ? y : WORLD_Y - 1);
+        }
+    }
+}
+
+static Tile *_get_tile(int x, int z) {
+    Tile *tile = NULL;
+    for (int i = 0; i < tile_count && !tile; i++)
+        if (tiles[i].x == x && tiles[i].z == z) tile = &tiles[i];
+    if (!tile && tile_count < tile_capacity) {
+        tile = &tiles[tile_count++];
+    } else if (!tile) {
+        // evict the least recently used tile
+        tile = &tiles[0];
+        for (int i = 1; i < tile_count; i++)
+            if (tiles[i].used < tile->used) tile = &tiles[i];
+    }
+    if (tile->x != x || tile->z != z || !tile->used) {
+        tile->x = x;
+        tile->z = z;
+        _sample_tile(tile);
+    }
+    tile->used = generation;
+    return tile;
+}
+
+static void _assemble(int origin_x, int origin_z) {
+    // window origins are tile aligned, so tiles copy in whole
+    int tx = origin_x / TILE_XZ;
+    int tz = origin_z / TILE_XZ;
+    generation++;
+    for (int i = 0; i < _WINDOW_TILES; i++) {
+        for (int j = 0; j < _WINDOW_TILES; j++) {
+            Tile *tile = _get_tile(tx + i, tz + j);
+            for (int x = 0; x < TILE_XZ; x++) {
+                memcpy(
+                    &pending[i * TILE_XZ + x][j * TILE_XZ],
+                    tile->heights[x],
+                    TILE_XZ
+                );
+            }
+        }
+    }
+    pgm_settle_heights(pending);
+    // warm the ring around the window for the next move
+    for (int i = -1; i < _RING_TILES - 1; i++) {
+        for (int j = -1; j < _RING_TILES - 1; j++) {
+            if (tx + i < 0 || tz + j < 0) continue;
+            if ((tx + i) * TILE_XZ >= terrain.x) continue;
+            if ((tz + j) * TILE_XZ >= terrain.z) continue;
+            _get_tile(tx + i, tz + j);
+        }
+    }
+}
+
+static void *_load_loop(void *arg) {
+    pthread_mutex_lock(&lock);
+    while (running) {
+        if (!requested) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+        int x = request_x;
+        int z = request_z;
+        pthread_mutex_unlock(&lock);
+        _assemble(x, z);
+        pthread_mutex_lock(&lock);
+        requested = false;
+        ready = true;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int _clamp_origin(int origin, int size) {
+    int last = (size - WORLD_XZ) / TILE_XZ * TILE_XZ;
+    return origin < 0 ? 0 : origin > last ? last : origin;
+}
+
+static void _apply(int origin_x, int origin_z) {
+    int dx = origin_x - window_x;
+    int dz = origin_z - window_z;
+    terrain_set_heights(pending);
+    player_pos.x += dx;
+    player_pos.z += dz;
+    for (int i = 0; i < laser_pool_size(); i++) {
+        laser_get(i)->from.x -= dx;
+        laser_get(i)->from.z -= dz;
+    }
+    unit_shift_all(dx, dz);
+    window_x = origin_x;
+    window_z = origin_z;
+    log_info(
+        "terrain window moved to {%d,%d}, %d tile(s) resident",
+        window_x, window_z, tile_count
+    );
+}
+
+bool stream_init(const char *filename) {
+    if (!pgm_stream_open(filename)) return false;
+    if (terrain.x < WORLD_XZ || terrain.z < WORLD_XZ) {
+        log_warn("map is smaller than the world, not streaming");
+        pgm_stream_close();
+        return false;
+    }
+    // same height scaling as a full load, taken from the header's maxval
+    unsigned y_max = terrain.y + terrain.y * 0.1f;
+    y_scale = (y_max - 1) / (WORLD_Y - 1.0);
+    long budget = (long) config.stream_budget * 1024 * 1024;
+    tile_capacity = (int) (budget / (long) sizeof(Tile));
+    if (tile_capacity < _RING_TILES * _RING_TILES * 2)
+        tile_capacity = _RING_TILES * _RING_TILES * 2;
+    tiles = calloc(tile_capacity, sizeof(Tile));
+    assert_ok(tiles, "could not allocate tiles");
+    // start centred, loading the first window in place
+    window_x = _clamp_origin(
+        (terrain.x - WORLD_XZ) / 2 / TILE_XZ * TILE_XZ, terrain.x
+    );
+    window_z = _clamp_origin(
+        (terrain.z - WORLD_XZ) / 2 / TILE_XZ * TILE_XZ, terrain.z
+    );
+    _assemble(window_x, window_z);
+    terrain_set_heights(pending);
+    running = true;
+    if (pthread_create(&loader, NULL, _load_loop, NULL)) {
+        running = false;
+        log_warn("could not start terrain loader, window is fixed");
+    }
+    log_info(
+        "streaming %dx%d map from {%d,%d} with %d tile slot(s)",
+        terrain.x, terrain.z, window_x, window_z, tile_capacity
+    );
+    return true;
+}
+
+void stream_shutdown() {
+    pthread_mutex_lock(&lock);
+    bool joining = running;
+    running = false;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    if (joining) pthread_join(loader, NULL);
+    pgm_stream_close();
+    free(tiles);
+    tiles = NULL;
+    tile_count = tile_capacity = 0;
+}
+
+bool stream_update() {
+    if (!running) return false;
+    pthread_mutex_lock(&lock);
+    bool swap = ready;
+    int x = request_x;
+    int z = request_z;
+    ready = false;
+    pthread_mutex_unlock(&lock);
+    if (swap) {
+        _apply(x, z);
+        return true;
+    }
+    // move a tile's width toward whichever edges the player is closing on
+    int px = (int) -player_pos.x;
+    int pz = (int) -player_pos.z;
+    x = window_x;
+    z = window_z;
+    if (px < TILE_XZ) x -= TILE_XZ;
+    else if (px >= WORLD_XZ - TILE_XZ) x += TILE_XZ;
+    if (pz < TILE_XZ) z -= TILE_XZ;
+    else if (pz >= WORLD_XZ - TILE_XZ) z += TILE_XZ;
+    x = _clamp_origin(x, terrain.x);
+    z = _clamp_origin(z, terrain.z);
+    if (x == window_x && z == window_z) return false;
+    pthread_mutex_lock(&lock);
+    if (!requested) {
+        request_x = x;
+        request_z = z;
+        requested = true;
+        pthread_cond_signal(&wake);
+    }
+    pthread_mutex_unlock(&lock);
+    return false;
+}
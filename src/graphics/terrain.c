@@ -0,0 +1,613 @@
+/**
+ * terrain.c
+ *
+ * Processed terrain shared by rendering and units: the surface height of each
+ * column (which doubles as the units' min-y table), the list of exposed
+ * voxels and the highest surface. These are written to a versioned binary
+ * cache keyed by the source PGM's hash and the world dimensions, and later
+ * runs memory-map the cache instead of reprocessing the map. A min/max
+ * pyramid over the heights lets the renderer merge distant columns.
+ *
+ * Every change bumps surface.epoch and is published to registered listeners
+ * with the bounds of the columns that changed, so caches derived from the
+ * terrain (the pyramid here, unit placement, the minimap) can rebuild only
+ * what they need while the game keeps running.
+ *
+ * Alongside the colours in world_terrain, world_solid packs which voxels are
+ * solid a bit each, 64 along z to a word, so exposure can be found a whole row
+ * at a time.
+ *
+ * Lasers carve the surface. Edits are queued and applied to the heights and
+ * world straight away, letting unsupported columns fall, while the exposed
+ * voxels (kept grouped by chunk) and the listeners catch up a chunk at a time
+ * within a per-frame budget.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+#include "world.h"
+
+#define _PATH_BUFFER 512
+#define _CHUNKS ((WORLD_XZ + TERRAIN_CHUNK_XZ - 1) / TERRAIN_CHUNK_XZ)
+#define _CHUNK_VOXELS (TERRAIN_CHUNK_XZ * TERRAIN_CHUNK_XZ * 2)
+
+typedef struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t world_xz;
+    uint32_t world_y;
+    uint32_t count;
+    uint64_t source_hash;
+    uint8_t y_max;
+    uint8_t reserved[31];
+} CacheHeader;
+
+extern Config config;
+extern Position player_pos;
+extern Surface surface;
+extern SolidMask world_solid;
+extern World world_terrain;
+
+static const char cache_magic[8] = "DEFTERR";
+static uint8_t heights[WORLD_XZ][WORLD_XZ];
+static uint8_t published[WORLD_XZ][WORLD_XZ];
+static void (*listeners[TERRAIN_LISTENERS_MAX])(int, int, int, int);
+static int listener_count = 0;
+static time_t source_mtime = 0;
+static off_t source_size = 0;
+static uint8_t pyramid_max[TERRAIN_LOD_LEVELS][WORLD_XZ][WORLD_XZ];
+static uint8_t pyramid_min[TERRAIN_LOD_LEVELS][WORLD_XZ][WORLD_XZ];
+static int chunk_start[_CHUNKS * _CHUNKS + 1];
+static bool dirty[_CHUNKS][_CHUNKS];
+static int dirty_count = 0;
+static Voxel edits[TERRAIN_EDITS_MAX];
+static int edit_count = 0;
+static int falling[WORLD_XZ * WORLD_XZ];
+static bool queued[WORLD_XZ][WORLD_XZ];
+static bool voxels_owned = false;
+static uint64_t exposed[WORLD_XZ][WORLD_Y][SOLID_WORDS];
+
+static void _release() {
+    if (surface.mapping) munmap(surface.mapping, surface.length);
+    if (voxels_owned) free(surface.voxels);
+    voxels_owned = false;
+    surface.mapping = NULL;
+    surface.length = 0;
+    surface.voxels = NULL;
+    surface.count = 0;
+    memset(dirty, 0, sizeof(dirty));
+    dirty_count = 0;
+    edit_count = 0;
+}
+
+static void _set_voxel(int x, int y, int z, Colour colour) {
+    uint64_t bit = 1ull << (z & 63);
+    world_at(world_terrain, x, y, z) = colour;
+    if (colour == COLOUR_NONE) world_solid[x][y][z >> 6] &= ~bit;
+    else world_solid[x][y][z >> 6] |= bit;
+}
+
+static void _write_columns(int from, int to, void *arg) {
+    // one surface cube per column, plus a floor under any column that isn't
+    // resting directly on it
+    for (int x = from; x < to; x++) {
+#ifdef WORLD_BRICKS
+        for (int y = 0; y < WORLD_Y; y++)
+            for (int z = 0; z < WORLD_XZ; z++)
+                world_at(world_terrain, x, y, z) = COLOUR_NONE;
+#else
+        memset(world_terrain[x], COLOUR_NONE, sizeof(world_terrain[x]));
+#endif
+        memset(world_solid[x], 0, sizeof(world_solid[x]));
+        for (int z = 0; z < WORLD_XZ; z++) {
+            _set_voxel(x, surface.heights[x][z], z, COLOUR_BLACK);
+            if (!world_at(world_terrain, x, 1, z))
+                _set_voxel(x, 0, z, COLOUR_BLACK);
+        }
+    }
+}
+
+static void _build_pyramid(int x0, int z0, int x1, int z1) {
+    // level n cell (x, z) bounds the 2^n x 2^n columns starting at (x, z) << n,
+    // only cells over columns in [x0, x1) x [z0, z1) are rebuilt
+    for (int x = x0; x < x1; x++) {
+        memcpy(&pyramid_max[0][x][z0], &surface.heights[x][z0], z1 - z0);
+        memcpy(&pyramid_min[0][x][z0], &surface.heights[x][z0], z1 - z0);
+    }
+    for (int level = 1; level < TERRAIN_LOD_LEVELS; level++) {
+        int below = (WORLD_XZ + (1 << (level - 1)) - 1) >> (level - 1);
+        int to_x = (x1 + (1 << level) - 1) >> level;
+        int to_z = (z1 + (1 << level) - 1) >> level;
+        for (int x = x0 >> level; x < to_x; x++) {
+            for (int z = z0 >> level; z < to_z; z++) {
+                uint8_t high = 0;
+                uint8_t low = UINT8_MAX;
+                for (int i = 0; i < 4; i++) {
+                    int cx = x * 2 + (i & 1);
+                    int cz = z * 2 + (i >> 1);
+                    if (cx >= below || cz >= below) continue;
+                    if (pyramid_max[level - 1][cx][cz] > high)
+                        high = pyramid_max[level - 1][cx][cz];
+                    if (pyramid_min[level - 1][cx][cz] < low)
+                        low = pyramid_min[level - 1][cx][cz];
+                }
+                pyramid_max[level][x][z] = high;
+                pyramid_min[level][x][z] = low;
+            }
+        }
+    }
+}
+
+static void _publish(int from_x, int from_z, int to_x, int to_z) {
+    // find what changed in the given columns since the last publish, then let
+    // dependents catch up
+    int x0 = WORLD_XZ, z0 = WORLD_XZ, x1 = 0, z1 = 0;
+    for (int x = from_x; x < to_x; x++) {
+        for (int z = from_z; z < to_z; z++) {
+            if (surface.epoch && published[x][z] == surface.heights[x][z])
+                continue;
+            if (x < x0) x0 = x;
+            if (z < z0) z0 = z;
+            if (x >= x1) x1 = x + 1;
+            if (z >= z1) z1 = z + 1;
+        }
+    }
+    if (x0 >= x1) return;
+    surface.epoch++;
+    for (int x = x0; x < x1; x++)
+        memcpy(&published[x][z0], &surface.heights[x][z0], z1 - z0);
+    _build_pyramid(x0, z0, x1, z1);
+    // the coarsest level bounds every column
+    int level = TERRAIN_LOD_LEVELS - 1;
+    int cells = (WORLD_XZ + (1 << level) - 1) >> level;
+    surface.y_max = 0;
+    for (int x = 0; x < cells; x++)
+        for (int z = 0; z < cells; z++)
+            if (pyramid_max[level][x][z] > surface.y_max)
+                surface.y_max = pyramid_max[level][x][z];
+    for (int i = 0; i < listener_count; i++) listeners[i](x0, z0, x1, z1);
+    log(
+        "terrain epoch %d changed {%d,%d}-{%d,%d}",
+        surface.epoch, x0, z0, x1, z1
+    );
+}
+
+static void _expose_rows(int from, int to, void *arg) {
+    // solid voxels with a face open to air or the world's edge, a row at a
+    // time; bits past the last z are never set, so both ends of a row come
+    // out exposed without a special case
+    for (int x = from; x < to; x++) {
+        for (int y = 0; y < WORLD_Y; y++) {
+            const uint64_t *row = world_solid[x][y];
+            if (x == 0 || x == WORLD_XZ - 1 || y == 0 || y == WORLD_Y - 1) {
+                memcpy(exposed[x][y], row, sizeof(exposed[x][y]));
+                continue;
+            }
+            for (int w = 0; w < SOLID_WORDS; w++) {
+                uint64_t covered = world_solid[x - 1][y][w]
+                    & world_solid[x + 1][y][w]
+                    & world_solid[x][y - 1][w] & world_solid[x][y + 1][w];
+                // neighbours along z, carried across word boundaries
+                covered &= row[w] >> 1
+                    | (w + 1 < SOLID_WORDS ? row[w + 1] << 63 : 0);
+                covered &= row[w] << 1 | (w ? row[w - 1] >> 63 : 0);
+                exposed[x][y][w] = row[w] & ~covered;
+            }
+        }
+    }
+}
+
+static int _index_chunk(int cx, int cz, Voxel *voxels) {
+    // columns hold at most a surface cube and a floor, so this never exceeds
+    // _CHUNK_VOXELS; the chunk's rows must have been exposed
+    int count = 0;
+    int z0 = cz * TERRAIN_CHUNK_XZ;
+    int x_to = (cx + 1) * TERRAIN_CHUNK_XZ;
+    int z_to = z0 + TERRAIN_CHUNK_XZ;
+    if (z_to > WORLD_XZ) z_to = WORLD_XZ;
+    uint64_t span[SOLID_WORDS] = {0};
+    for (int z = z0; z < z_to; z++) span[z >> 6] |= 1ull << (z & 63);
+    for (int x = cx * TERRAIN_CHUNK_XZ; x < x_to && x < WORLD_XZ; x++) {
+        int top = 0;
+        for (int z = z0; z < z_to; z++)
+            if (surface.heights[x][z] > top) top = surface.heights[x][z];
+        for (int y = 0; y <= top; y++) {
+            for (int w = 0; w < SOLID_WORDS; w++) {
+                for (uint64_t bits = exposed[x][y][w] & span[w]; bits;
+                        bits &= bits - 1) {
+                    int z = w * 64 + __builtin_ctzll(bits);
+                    voxels[count++] = (Voxel) {x, y, z};
+                }
+            }
+        }
+    }
+    return count;
+}
+
+static void _index_surface() {
+    // grouped by chunk so a chunk's voxels can be replaced on their own
+    Voxel *voxels = malloc(WORLD_XZ * WORLD_XZ * 2 * sizeof(Voxel));
+    assert_ok(voxels, "could not allocate surface");
+    jobs_parallel_for(0, WORLD_XZ, 8, _expose_rows, NULL);
+    int count = 0;
+    for (int c = 0; c < _CHUNKS * _CHUNKS; c++) {
+        chunk_start[c] = count;
+        count += _index_chunk(c / _CHUNKS, c % _CHUNKS, &voxels[count]);
+    }
+    chunk_start[_CHUNKS * _CHUNKS] = count;
+    if (voxels_owned) free(surface.voxels);
+    voxels_owned = true;
+    surface.voxels = voxels;
+    surface.count = count;
+}
+
+static void _find_chunks() {
+    // cached voxels are stored grouped by chunk, only the offsets are needed
+    int c = 0;
+    for (int i = 0; i < surface.count; i++) {
+        int chunk = surface.voxels[i].x / TERRAIN_CHUNK_XZ * _CHUNKS
+            + surface.voxels[i].z / TERRAIN_CHUNK_XZ;
+        while (c <= chunk) chunk_start[c++] = i;
+    }
+    while (c <= _CHUNKS * _CHUNKS) chunk_start[c++] = surface.count;
+}
+
+static void _own_voxels() {
+    // edits need a voxel list that can be resized, the heights can stay in
+    // the private mapping
+    Voxel *voxels = malloc(WORLD_XZ * WORLD_XZ * 2 * sizeof(Voxel));
+    assert_ok(voxels, "could not allocate surface");
+    memcpy(voxels, surface.voxels, surface.count * sizeof(Voxel));
+    voxels_owned = true;
+    surface.voxels = voxels;
+}
+
+static void _rebuild_chunk(int cx, int cz) {
+    // splice the chunk's new voxels in place of its old ones
+    Voxel fresh[_CHUNK_VOXELS];
+    int x0 = cx * TERRAIN_CHUNK_XZ;
+    int z0 = cz * TERRAIN_CHUNK_XZ;
+    int x1 = x0 + TERRAIN_CHUNK_XZ;
+    int z1 = z0 + TERRAIN_CHUNK_XZ;
+    if (x1 > WORLD_XZ) x1 = WORLD_XZ;
+    if (z1 > WORLD_XZ) z1 = WORLD_XZ;
+    _expose_rows(x0, x1, NULL);
+    int count = _index_chunk(cx, cz, fresh);
+    int c = cx * _CHUNKS + cz;
+    int delta = count - (chunk_start[c + 1] - chunk_start[c]);
+    memmove(
+        &surface.voxels[chunk_start[c + 1] + delta],
+        &surface.voxels[chunk_start[c + 1]],
+        (surface.count - chunk_start[c + 1]) * sizeof(Voxel)
+    );
+    memcpy(&surface.voxels[chunk_start[c]], fresh, count * sizeof(Voxel));
+    for (int i = c + 1; i <= _CHUNKS * _CHUNKS; i++) chunk_start[i] += delta;
+    surface.count += delta;
+    _publish(x0, z0, x1, z1);
+}
+
+static void _set_column(int x, int z, uint8_t height) {
+    // a column is only its surface cube and, if that isn't resting on it, a
+    // floor cube
+    _set_voxel(x, surface.heights[x][z], z, COLOUR_NONE);
+    _set_voxel(x, 0, z, COLOUR_NONE);
+    surface.heights[x][z] = height;
+    _set_voxel(x, height, z, COLOUR_BLACK);
+    if (!world_at(world_terrain, x, 1, z)) _set_voxel(x, 0, z, COLOUR_BLACK);
+    for (int i = x - 1; i <= x + 1; i++) {
+        for (int j = z - 1; j <= z + 1; j++) {
+            if (i < 0 || j < 0 || i >= WORLD_XZ || j >= WORLD_XZ) continue;
+            bool *chunk = &dirty[i / TERRAIN_CHUNK_XZ][j / TERRAIN_CHUNK_XZ];
+            if (!*chunk) dirty_count++;
+            *chunk = true;
+        }
+    }
+}
+
+static void _push_around(int x, int z, int *count) {
+    for (int i = x - 1; i <= x + 1; i++) {
+        for (int j = z - 1; j <= z + 1; j++) {
+            if (i < 0 || j < 0 || i >= WORLD_XZ || j >= WORLD_XZ) continue;
+            if (queued[i][j]) continue;
+            queued[i][j] = true;
+            falling[(*count)++] = i * WORLD_XZ + j;
+        }
+    }
+}
+
+static void _carve(Voxel voxel) {
+    // lower the column, then drop any column left floating by the same rules
+    // the map was settled with, spreading only as far as columns move
+    if (surface.heights[voxel.x][voxel.z] != voxel.y) return;
+    _set_column(voxel.x, voxel.z, voxel.y - 1);
+    int count = 0;
+    _push_around(voxel.x, voxel.z, &count);
+    while (count) {
+        int x = falling[--count] / WORLD_XZ;
+        int z = falling[count] % WORLD_XZ;
+        queued[x][z] = false;
+        uint8_t height = surface.heights[x][z];
+        uint8_t y = height;
+        while (y > 1 && pgm_is_floating_block(x, y, z)) y--;
+        if (y == height) continue;
+        _set_column(x, z, y);
+        _push_around(x, z, &count);
+    }
+}
+
+static bool _make_dirs(char *dir) {
+    // mkdir -p, creating each missing component in turn
+    char *slash = dir;
+    while ((slash = strchr(slash + 1, '/'))) {
+        *slash = '\0';
+        bool failed = mkdir(dir, 0755) && errno != EEXIST;
+        *slash = '/';
+        if (failed) return false;
+    }
+    return !mkdir(dir, 0755) || errno == EEXIST;
+}
+
+static bool _cache_path(char *path, uint64_t hash) {
+    char dir[_PATH_BUFFER];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (config.cache_dir) {
+        snprintf(dir, sizeof(dir), "%s", config.cache_dir);
+    } else if (xdg && *xdg) {
+        snprintf(dir, sizeof(dir), "%s/defender", xdg);
+    } else if (home && *home) {
+        snprintf(dir, sizeof(dir), "%s/.cache/defender", home);
+    } else {
+        return false;
+    }
+    if (!_make_dirs(dir)) return false;
+    int length = snprintf(
+        path, _PATH_BUFFER, "%s/terrain-%016llx-%dx%d.v%d",
+        dir, (unsigned long long) hash, WORLD_XZ, WORLD_Y,
+        TERRAIN_CACHE_VERSION
+    );
+    return length < _PATH_BUFFER;
+}
+
+static bool _cache_records_valid(const CacheHeader *header) {
+    // a sound header doesn't vouch for the records, and they index the world
+    const uint8_t (*cached)[WORLD_XZ] = (const uint8_t (*)[WORLD_XZ])
+        (header + 1);
+    const Voxel *records = (const Voxel *)
+        ((const char *) cached + sizeof(heights));
+    if (header->y_max >= WORLD_Y) return false;
+    for (int x = 0; x < WORLD_XZ; x++)
+        for (int z = 0; z < WORLD_XZ; z++)
+            if (cached[x][z] >= WORLD_Y) return false;
+    for (uint32_t i = 0; i < header->count; i++) {
+        Voxel v = records[i];
+        if (v.x >= WORLD_XZ || v.y >= WORLD_Y || v.z >= WORLD_XZ) return false;
+    }
+    return true;
+}
+
+static bool _cache_read(const char *path, uint64_t hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void *map = MAP_FAILED;
+    if (!fstat(fd, &info) && info.st_size >= (off_t) sizeof(CacheHeader)) {
+        // private writable mapping so later edits stay copy-on-write
+        map = mmap(
+            NULL, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, 0
+        );
+    }
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    CacheHeader *header = map;
+    size_t length = (size_t) info.st_size;
+    size_t expected = sizeof(CacheHeader) + sizeof(heights)
+        + header->count * sizeof(Voxel);
+    if (memcmp(header->magic, cache_magic, sizeof(cache_magic)) ||
+        header->version != TERRAIN_CACHE_VERSION ||
+        header->world_xz != WORLD_XZ || header->world_y != WORLD_Y ||
+        header->source_hash != hash || length != expected) {
+        log_warn("ignoring stale terrain cache %s", path);
+        munmap(map, length);
+        return false;
+    }
+    if (!_cache_records_valid(header)) {
+        log_warn("ignoring corrupt terrain cache %s", path);
+        munmap(map, length);
+        return false;
+    }
+    _release();
+    surface.mapping = map;
+    surface.length = length;
+    surface.heights = (uint8_t (*)[WORLD_XZ]) (header + 1);
+    surface.voxels = (Voxel *) ((char *) surface.heights + sizeof(heights));
+    surface.count = (int) header->count;
+    surface.y_max = header->y_max;
+    jobs_parallel_for(0, WORLD_XZ, 8, _write_columns, NULL);
+    _find_chunks();
+    _publish(0, 0, WORLD_XZ, WORLD_XZ);
+    return true;
+}
+
+static void _cache_write(const char *path, uint64_t hash) {
+    char temp[_PATH_BUFFER + 8];
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int) getpid());
+    FILE *file = fopen(temp, "wb");
+    if (!file) {
+        log_warn("could not write terrain cache %s", temp);
+        return;
+    }
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = TERRAIN_CACHE_VERSION;
+    header.world_xz = WORLD_XZ;
+    header.world_y = WORLD_Y;
+    header.count = (uint32_t) surface.count;
+    header.source_hash = hash;
+    header.y_max = surface.y_max;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(surface.heights, sizeof(heights), 1, file) == 1 &&
+        fwrite(surface.voxels, sizeof(Voxel), surface.count, file)
+            == (size_t) surface.count;
+    // rename into place so readers never see a partial file
+    if (fclose(file) || !written || rename(temp, path)) {
+        log_warn("could not write terrain cache %s", path);
+        unlink(temp);
+    }
+}
+
+const Voxel *terrain_chunk_voxels(int cx, int cz, int *count) {
+    // exposed voxels of one chunk, valid until it is next rebuilt
+    int c = cx * _CHUNKS + cz;
+    *count = chunk_start[c + 1] - chunk_start[c];
+    return &surface.voxels[chunk_start[c]];
+}
+
+bool terrain_carve(int x, int y, int z) {
+    // only surface cubes above the floor can be removed
+    if (x < 0 || z < 0 || x >= WORLD_XZ || z >= WORLD_XZ) return false;
+    if (y < 1 || y != surface.heights[x][z]) return false;
+    for (int i = 0; i < edit_count; i++)
+        if (edits[i].x == x && edits[i].y == y && edits[i].z == z) return true;
+    if (edit_count == TERRAIN_EDITS_MAX) return false;
+    edits[edit_count++] = (Voxel) {x, y, z};
+    return true;
+}
+
+bool terrain_solid(int x, int y, int z) {
+    if (x < 0 || y < 0 || z < 0) return false;
+    if (x >= WORLD_XZ || y >= WORLD_Y || z >= WORLD_XZ) return false;
+    return world_solid[x][y][z >> 6] >> (z & 63) & 1;
+}
+
+void terrain_generate() {
+    // synthetic worlds are cheap to rebuild, so they skip the cache
+    double start = profile_now();
+    float roughness = config.gen_roughness / 100.0f;
+    noise_generate(config.gen_size, (unsigned) config.gen_seed, roughness);
+    pgm_set_world_terrain();
+    log_info(
+        "generated %dx%d terrain (seed %d, roughness %d%%) in %.1f ms",
+        config.gen_size, config.gen_size, config.gen_seed,
+        config.gen_roughness, profile_now() - start
+    );
+}
+
+void terrain_listen(void (*listener)(int x0, int z0, int x1, int z1)) {
+    assert_lt(listener_count, TERRAIN_LISTENERS_MAX, "too many listeners");
+    listeners[listener_count++] = listener;
+    if (surface.epoch) listener(0, 0, WORLD_XZ, WORLD_XZ);
+}
+
+bool terrain_load(const char *filename) {
+    double start = profile_now();
+    struct stat info;
+    const char *path_found = pgm_find(filename);
+    bool found = path_found && !stat(path_found, &info);
+    source_mtime = found ? info.st_mtime : 0;
+    source_size = found ? info.st_size : 0;
+    char path[_PATH_BUFFER];
+    uint64_t hash = config.use_cache ? pgm_hash(filename) : 0;
+    bool cached = hash && _cache_path(path, hash);
+    if (cached && _cache_read(path, hash)) {
+        log_info(
+            "terrain loaded from %s in %.1f ms", path, profile_now() - start
+        );
+        return true;
+    }
+    if (!pgm_init(filename)) return false;
+    pgm_set_world_terrain();
+    if (cached) _cache_write(path, hash);
+    log_info("terrain processed in %.1f ms", profile_now() - start);
+    return true;
+}
+
+uint8_t terrain_lod_max(int level, int x, int z) {
+    return pyramid_max[level][x][z];
+}
+
+uint8_t terrain_lod_min(int level, int x, int z) {
+    return pyramid_min[level][x][z];
+}
+
+bool terrain_poll() {
+    // reload once the map on disk has been replaced and then left alone for a
+    // whole poll, so a file still being written isn't picked up
+    static double checked = 0;
+    static time_t seen_mtime = 0;
+    static off_t seen_size = -1;
+    double now = profile_now();
+    if (config.stream || config.gen_size > 0) return false;
+    if (now - checked < TERRAIN_POLL_MS) return false;
+    checked = now;
+    struct stat info;
+    const char *path = pgm_find(config.map_file);
+    if (!path || stat(path, &info)) return false;
+    if (info.st_mtime == source_mtime && info.st_size == source_size)
+        return false;
+    bool settled = info.st_mtime == seen_mtime && info.st_size == seen_size;
+    seen_mtime = info.st_mtime;
+    seen_size = info.st_size;
+    if (!settled) return false;
+    log_info("%s changed on disk", config.map_file);
+    return terrain_reload();
+}
+
+bool terrain_reload() {
+    if (config.stream || config.gen_size > 0) {
+        log_warn("only maps loaded whole can be reloaded");
+        return false;
+    }
+    if (!terrain_load(config.map_file)) {
+        log_warn("keeping the current terrain");
+        return false;
+    }
+    // lift the player clear of anything that rose around them
+    int x = (int) -player_pos.x;
+    int z = (int) -player_pos.z;
+    if (x > 0 && x < WORLD_XZ - 1 && z > 0 && z < WORLD_XZ - 1) {
+        int top = 0;
+        for (int i = x - 1; i <= x + 1; i++)
+            for (int j = z - 1; j <= z + 1; j++)
+                if (surface.heights[i][j] > top) top = surface.heights[i][j];
+        if (-player_pos.y < top + 2) player_pos.y = -(top + 2.0f);
+    }
+    return true;
+}
+
+void terrain_set_heights(uint8_t source[WORLD_XZ][WORLD_XZ]) {
+    _release();
+    memcpy(heights, source, sizeof(heights));
+    surface.heights = heights;
+    jobs_parallel_for(0, WORLD_XZ, 8, _write_columns, NULL);
+    _index_surface();
+    _publish(0, 0, WORLD_XZ, WORLD_XZ);
+}
+
+bool terrain_update() {
+    // apply queued edits, then rebuild dirty chunks until the budget runs out
+    if (!edit_count && !dirty_count) return false;
+    double start = profile_now();
+    for (int i = 0; i < edit_count; i++) _carve(edits[i]);
+    edit_count = 0;
+    if (!voxels_owned) _own_voxels();
+    for (int cx = 0; cx < _CHUNKS && dirty_count; cx++) {
+        for (int cz = 0; cz < _CHUNKS && dirty_count; cz++) {
+            if (!dirty[cx][cz]) continue;
+            if (profile_now() - start > TERRAIN_EDIT_MS) return true;
+            _rebuild_chunk(cx, cz);
+            dirty[cx][cz] = false;
+            dirty_count--;
+        }
+    }
+    return true;
+}
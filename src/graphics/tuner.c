@@ -0,0 +1,97 @@
+/**
+ * tuner.c
+ *
+ * Picks the octree leaf size and traversal depth for the current map and
+ * machine, trading plane tests against per-voxel work. Every setting is tried
+ * in turn, a frame at a time, so all of them see much the same views; after
+ * TUNER_ROUNDS rounds the one with the lowest median frame time is kept.
+ */
+
+#include "debug.h"
+#include "exec.h"
+#include "graphics.h"
+
+typedef struct setting {
+    int leaf;
+    int depth;
+    double ms[TUNER_ROUNDS];
+} Setting;
+
+extern Config config;
+
+static Setting settings[TUNER_SETTINGS_MAX];
+static int setting_count = 0;
+static int current = 0;
+static int rounds = 0;
+static bool tuning = false;
+
+static void _apply(Setting *setting) {
+    bool rebuild = setting->leaf != config.octree_leaf;
+    config.octree_leaf = setting->leaf;
+    config.octree_depth = setting->depth;
+    if (rebuild) octree_rebuild();
+}
+
+static void _finish() {
+    Setting *best = &settings[0];
+    double best_ms = 0;
+    for (int i = 0; i < setting_count; i++) {
+        qsort(
+            settings[i].ms, TUNER_ROUNDS, sizeof(double), profile_compare_ms
+        );
+        double median = settings[i].ms[TUNER_ROUNDS / 2];
+        log(
+            "octree %d leaves, depth %d: median %.3f ms",
+            settings[i].leaf, settings[i].depth, median
+        );
+        if (i && median >= best_ms) continue;
+        best = &settings[i];
+        best_ms = median;
+    }
+    tuning = false;
+    _apply(best);
+    log_info(
+        "tuned octree to %d voxel leaves, depth %d (median %.3f ms)",
+        best->leaf, best->depth, best_ms
+    );
+}
+
+bool tuner_active() {
+    return tuning;
+}
+
+void tuner_frame(double ms) {
+    // record the setting just drawn, then move on to the next
+    if (!tuning) return;
+    settings[current].ms[rounds] = ms;
+    if (++current == setting_count) {
+        current = 0;
+        if (++rounds == TUNER_ROUNDS) {
+            _finish();
+            return;
+        }
+    }
+    _apply(&settings[current]);
+}
+
+int tuner_round() {
+    return rounds;
+}
+
+void tuner_start() {
+    // leaves from a single LOD patch up, each stopping at every depth down to
+    // them
+    int patch = 1 << (TERRAIN_LOD_LEVELS - 1);
+    setting_count = 0;
+    for (int leaf = patch; leaf < WORLD_XZ; leaf *= 2) {
+        for (int depth = 1; depth <= octree_levels(leaf); depth++) {
+            if (setting_count == TUNER_SETTINGS_MAX) break;
+            settings[setting_count++] = (Setting) {leaf, depth, {0}};
+        }
+    }
+    current = rounds = 0;
+    tuning = setting_count > 0;
+    if (!tuning) return;
+    log_info("tuning the octree over %d settings", setting_count);
+    _apply(&settings[0]);
+}
@@ -1,35 +1,27 @@
 #include <algorithm>
-#include <iostream>
-#include <random>
 #include "debug.h"
 #include "units.hpp"
+#include "world.h"
 
 using namespace std;
 
 extern World world_terrain;
 extern World world_units;
 extern Config config;
-
-static uint8 _gen_random(int min, int max) {
-    static random_device rd;
-    static mt19937 seed(rd());
-    uniform_int_distribution<> distribution(min, max);
-    int result = distribution(seed);
-    assert_gte(result, 0, "underflow imminent");
-    assert_lte(result, 255, "overflow imminent");
-    return static_cast<uint8>(result);
-}
+extern "C" Surface surface;
 
 vector<Unit *> Unit::units;
+Unit *Unit::occupants[WORLD_XZ][WORLD_Y][WORLD_XZ] = {{{nullptr}}};
 uint8 Unit::cycle = 0;
+long Unit::next_id = 1;
 
 Unit::Unit(int x, int y, int z, string name) :
-    id(units.size() + 1),
+    id(next_id++),
     is_colliding_ground(false),
     is_colliding_unit(false),
     target({x, max(y, WORLD_Y - MAP_CLEAR), z}),
     origin(target),
-    as_str(name + " #" + to_string(units.size()))
+    as_str(name + " #" + to_string(id))
 {
     units.push_back(this);
     assert_gte(x, 0, "x out of bounds");
@@ -42,6 +34,12 @@ Unit::Unit(int x, int y, int z, string name) :
 }
 
 Unit::~Unit() {
+    for (auto const &mapping : layout) {
+        Unit *&occupant = occupants[origin.x + mapping.first[0]]
+                                   [origin.y + mapping.first[1]]
+                                   [origin.z + mapping.first[2]];
+        if (occupant == this) occupant = nullptr;
+    }
     auto iter = find(units.begin(), units.end(), this);
     if (iter != units.end()) {
         log("%s destroyed", as_str.c_str());
@@ -52,61 +50,11 @@ Unit::~Unit() {
 }
 
 uint8 Unit::calc_min_y(int x, int z) {
-    static int minimums[WORLD_XZ][WORLD_XZ] = {{-1}};
-    static bool calculated = false;  // only need to compute once
-    if (!calculated) {
-        Coordinate c;
-        for (c.x = 0; c.x < WORLD_XZ; c.x++) {
-            for (c.z = 0; c.z < WORLD_XZ; c.z++) {
-                for (c.y = WORLD_Y - 1; c.y >= 0; c.y--) {
-                    if (world_terrain[c.x][c.y][c.z]) {
-                        minimums[c.x][c.z] = c.y;
-                        break;
-                    }
-                }
-                assert_gt(minimums[c.x][c.z], -1, "couldn't determine min");
-            }
-        }
-        calculated = true;
-    }
-    return static_cast<uint8>(minimums[x][z]);
+    return surface.heights[x][z];
 }
 
 uint8 Unit::calc_min_y() {
-    static uint8 y_min = 0;
-    if (y_min) return y_min;  // only needs to be calculated once
-    for (int x = 0; x < WORLD_XZ; x++)
-        for (int z = 0; z < WORLD_XZ; z++)
-            y_min = max(y_min, calc_min_y(x, z));
-    return y_min;
-}
-
-coordinate Unit::calc_random_coordinate(bool edge, bool above_terrain) {
-    uint8 x = _gen_random(MAP_CLEAR, WORLD_XZ - MAP_CLEAR);
-    uint8 z = _gen_random(MAP_CLEAR, WORLD_XZ - MAP_CLEAR);
-    const uint8 y_from = above_terrain ? calc_min_y(x, z) : 1;
-    const uint8 y_to =WORLD_Y - MAP_CLEAR;
-    uint8 y = _gen_random(y_from, y_to);
-    Coordinate c = {x, y, z};
-    if (edge) {
-        switch (_gen_random(0, 4)) {
-            case 0:
-                c.x = MAP_CLEAR;
-                break;
-            case 1:
-                c.x = WORLD_XZ - MAP_CLEAR;
-                break;
-            case 2:
-                c.z = MAP_CLEAR;
-                break;
-            default:
-                c.z = WORLD_XZ - MAP_CLEAR;
-                break;
-        }
-    }
-    bool already_occupied = world_units[c.x][c.y][c.z] ||
-        world_terrain[c.x][c.y][c.z];
-    return already_occupied ? calc_random_coordinate(edge) : c;
+    return surface.y_max;
 }
 
 int Unit::y_distance(const Unit *target) {
@@ -120,12 +68,8 @@ int Unit::y_distance(const Unit *target) {
 }
 
 Unit *Unit::find_unit(Coordinate coordinate) {
-    for (Unit *unit: Unit::units) {
-        if (unit->is_occupying(coordinate)) {
-            return unit;
-        }
-    }
-    return nullptr;
+    Unit *unit = occupants[coordinate.x][coordinate.y][coordinate.z];
+    return unit && unit->is_occupying(coordinate) ? unit : nullptr;
 }
 
 void Unit::ai() {
@@ -156,15 +100,52 @@ void Unit::render() {
         int y = origin.y + positions[1];
         int z = origin.z + positions[2];
         // Determine if colliding
-        if (world_terrain[x][y][z])is_colliding_ground = true;
-        else if (world_units[x][y][z]) is_colliding_unit = true;
+        if (world_at(world_terrain, x, y, z)) is_colliding_ground = true;
+        else if (world_at(world_units, x, y, z)) is_colliding_unit = true;
         // Draw unit
-        world_units[x][y][z] = colour;
+        world_at(world_units, x, y, z) = colour;
+        occupants[x][y][z] = this;
+    }
+}
+
+bool Unit::shift(int dx, int dz) {
+    // follow the terrain as the streamed window moves; units that would leave
+    // the area they are kept to stay put and report it
+    int x = origin.x - dx;
+    int z = origin.z - dz;
+    if (x < MAP_CLEAR || x > WORLD_XZ - MAP_CLEAR) return false;
+    if (z < MAP_CLEAR || z > WORLD_XZ - MAP_CLEAR) return false;
+    origin.x = x;
+    origin.z = z;
+    target.x -= dx;
+    target.z -= dz;
+    settle();
+    return true;
+}
+
+void Unit::settle() {
+    // lift clear of terrain that has risen into the unit
+    bool buried = true;
+    while (buried && origin.y < WORLD_Y - 2) {
+        buried = false;
+        for (auto const &mapping : layout) {
+            if (world_at(
+                    world_terrain,
+                    origin.x + mapping.first[0],
+                    origin.y + mapping.first[1],
+                    origin.z + mapping.first[2]
+                )) buried = true;
+        }
+        if (buried) origin.y++;
     }
+    target.y = max(target.y, origin.y);
+}
+
+void Unit::think() {
 }
 
 void Unit::shoot() {
-    cout << as_str + " shot down" << endl;
+    log_info("%s shot down", as_str.c_str());
     delete this;
 }
 
@@ -1,6 +1,6 @@
-#include <iostream>
 #include "debug.h"
 #include "units.hpp"
+#include "world.h"
 
 using namespace std;
 
@@ -12,7 +12,7 @@ Human::Human(int x, int y, int z) : Unit(x, y, z, "human") {
     layout[{+0, +1, +0}] = COLOUR_ORANGE;
     terrain_height = 2;
     for (; y > 2; y--) {
-        if (world_terrain[x][y][z]) {
+        if (world_at(world_terrain, x, y, z)) {
             terrain_height += y;
             break;
         }
@@ -23,7 +23,7 @@ Human::Human(int x, int y, int z) : Unit(x, y, z, "human") {
 Human::Human(Coordinate coordinate) :
     Human(coordinate.x, coordinate.y, coordinate.z) {}
 
-Human::Human() : Human(calc_random_coordinate()) {}
+Human::Human() : Human(calc_random_coordinate(false, true, true)) {}
 
 Human::~Human() {
     Lander *lander;
@@ -40,9 +40,9 @@ void Human::ai() {
         case SETTLED:
             if (fall_height >= LETHAL_FALL_HEIGHT) {
                 state = KILLED;
-                cout << as_str + " fell to their death" << endl;
+                log_info("%s fell to their death", as_str.c_str());
             } else if (fall_height) {
-                cout << as_str + " fell but they're ok" << endl;
+                log_info("%s fell but they're ok", as_str.c_str());
                 fall_height = 0;
             }
             break;
@@ -65,6 +65,16 @@ void Human::ai() {
     Unit::ai();
 }
 
+void Human::settle() {
+    // the ground underneath may have changed height
+    uint8 surface = calc_min_y(origin.x, origin.z);
+    terrain_height = surface > 2 ? surface + 2 : 2;
+    if (state == SETTLED || (state == FALLING && origin.y < terrain_height))
+        origin.y = target.y = terrain_height;
+    else if (state != FLOATING)
+        Unit::settle();
+}
+
 void Human::render() {
     if (state == FLOATING) {
         Layout next_layout;
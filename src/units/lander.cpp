@@ -1,15 +1,15 @@
 #include <algorithm>
 #include <cmath>
-#include <iostream>
 #include "debug.h"
+#include "exec.h"
 #include "units.hpp"
+#include "world.h"
 
 using namespace std;
 
 extern World world_terrain;
 extern World world_units;
 extern Position player_pos;
-extern Laser lasers[];
 
 Lander::Lander(int x, int y, int z) : Unit(x, y, z, "lander") {
     layout[{-2, -2, +0}] = COLOUR_GREEN;
@@ -28,12 +28,12 @@ Lander::Lander(Coordinate coordinate)
     : Lander(coordinate.x, coordinate.y, coordinate.z) {
 }
 
-Lander::Lander() : Lander(calc_random_coordinate(true)) {
+Lander::Lander() : Lander(calc_random_coordinate(true, true, true)) {
 }
 
 Lander::~Lander() {
     if (captive) captive->action_drop();
-    lasers[id].active = false;
+    laser_release(laser);
 }
 
 void Lander::new_search_path() {
@@ -141,16 +141,18 @@ void Lander::action_attack() {
     if (origin.x == target.x && origin.y == target.y && origin.z == target.z) {
         target = calc_random_coordinate();
     }
+    if (laser < 0) laser = laser_acquire();
+    Laser *beam = laser_get(laser);
     bool is_firing = can_shoot_player();
-    lasers[id].active = is_firing;
+    beam->active = is_firing;
     if (!is_firing) return;
-    lasers[id].to.x = (origin.x - (player_pos.x * -1)) * -1;
-    lasers[id].to.y = (origin.y - (player_pos.y * -1)) * -1 - 1;
-    lasers[id].to.z = (origin.z - (player_pos.z * -1)) * -1;
-    lasers[id].from.x = origin.x;
-    lasers[id].from.y = origin.y;
-    lasers[id].from.z = origin.z;
-    cout << as_str + " shot player!" << endl;
+    beam->to.x = (origin.x - (player_pos.x * -1)) * -1;
+    beam->to.y = (origin.y - (player_pos.y * -1)) * -1 - 1;
+    beam->to.z = (origin.z - (player_pos.z * -1)) * -1;
+    beam->from.x = origin.x;
+    beam->from.y = origin.y;
+    beam->from.z = origin.z;
+    log_info("%s shot player!", as_str.c_str());
 }
 
 void Lander::action_kill() {
@@ -169,6 +171,17 @@ bool Lander::can_capture() {
 }
 
 bool Lander::can_pursue(Human **rval) {
+    // trust what think() sighted unless that human has since been taken
+    if (sighted.y < 0) return false;
+    *rval = dynamic_cast<Human *>(find_unit(sighted));
+    if (*rval && (*rval)->available) return true;
+    if (!find_human(&sighted)) return false;
+    *rval = dynamic_cast<Human *>(find_unit(sighted));
+    return true;
+}
+
+bool Lander::find_human(Coordinate *cell) {
+    // first available human in range, scanning up to the lander's height
     Coordinate idx1;  // coordinate from
     idx1.x = max(origin.x - LANDER_SEARCH_RANGE, 0);
     idx1.z = max(origin.z - LANDER_SEARCH_RANGE, 0);
@@ -181,10 +194,11 @@ bool Lander::can_pursue(Human **rval) {
     for (idx.x = idx1.x; idx.x < idx2.x; idx.x++) {
         for (idx.z = idx1.z; idx.z < idx2.z; idx.z++) {
             for (idx.y = idx1.y; idx.y < idx2.y; idx.y++) {
-                if (world_units[idx.x][idx.y][idx.z]) {
-                    *rval = dynamic_cast<Human *>(find_unit(idx));
-                    if (*rval && (*rval)->available) return true;
-                }
+                if (!world_at(world_units, idx.x, idx.y, idx.z)) continue;
+                Human *human = dynamic_cast<Human *>(find_unit(idx));
+                if (!human || !human->available) continue;
+                *cell = idx;
+                return true;
             }
         }
     }
@@ -247,6 +261,13 @@ void Lander::render() {
     Unit::render();
 }
 
+void Lander::think() {
+    // only reads the world, so every lander can look at once
+    sighted.y = -1;
+    if (state >= ATTACKING || daze_counter) return;
+    find_human(&sighted);
+}
+
 void Lander::abandon_captive(bool drop) {
     if (!captive) return;
     if (drop) captive->action_drop();
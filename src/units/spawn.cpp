@@ -0,0 +1,161 @@
+/**
+ * spawn.cpp
+ *
+ * Index of unoccupied cells used to place units in O(1). Free cells are kept
+ * per x/z column, split into those above and below the terrain surface, and
+ * each spawn region keeps a list of the columns that still have free cells.
+ * Sampling picks a column from a region list and a cell from that column;
+ * claiming a cell swap-removes it from both.
+ */
+
+#include <algorithm>
+#include <random>
+#include "debug.h"
+#include "units.hpp"
+#include "world.h"
+
+using namespace std;
+
+extern World world_terrain;
+extern World world_units;
+
+namespace {
+
+enum Band { ABOVE = 0, ANY, BAND_COUNT };
+enum Region { EDGE = 0, INTERIOR, REGION_COUNT };
+
+struct Column {
+    uint8 cells[BAND_COUNT][WORLD_Y];  // above and below the surface
+    uint8 count[BAND_COUNT];
+    uint8 slot[WORLD_Y];
+    uint8 surface;
+};
+
+struct ColumnList {
+    vector<int> members;
+    vector<int> slot;
+};
+
+Column columns[WORLD_XZ][WORLD_XZ];
+ColumnList regions[REGION_COUNT][BAND_COUNT];
+bool indexed = false;
+mt19937 generator{random_device{}()};
+
+size_t _gen_index(size_t count) {
+    return uniform_int_distribution<size_t>(0, count - 1)(generator);
+}
+
+bool _in_region(Region region, int x, int z) {
+    const int lo = MAP_CLEAR, hi = WORLD_XZ - MAP_CLEAR;
+    if (x < lo || x > hi || z < lo || z > hi) return false;
+    return region == INTERIOR || x == lo || x == hi || z == lo || z == hi;
+}
+
+int _band_count(const Column &column, Band band) {
+    // ANY covers cells both above and below the surface
+    return band == ABOVE ? column.count[ABOVE]
+                         : column.count[ABOVE] + column.count[ANY];
+}
+
+void _update_lists(int x, int z) {
+    const int id = x * WORLD_XZ + z;
+    for (int r = 0; r < REGION_COUNT; r++) {
+        if (!_in_region(static_cast<Region>(r), x, z)) continue;
+        for (int b = 0; b < BAND_COUNT; b++) {
+            ColumnList &list = regions[r][b];
+            bool listed = list.slot[id] >= 0;
+            Band band = static_cast<Band>(b);
+            bool has_free = _band_count(columns[x][z], band) > 0;
+            if (has_free && !listed) {
+                list.slot[id] = static_cast<int>(list.members.size());
+                list.members.push_back(id);
+            } else if (!has_free && listed) {
+                int last = list.members.back();
+                list.members[list.slot[id]] = last;
+                list.slot[last] = list.slot[id];
+                list.members.pop_back();
+                list.slot[id] = -1;
+            }
+        }
+    }
+}
+
+void _index_column(int x, int z, uint8 surface) {
+    Column &column = columns[x][z];
+    column.count[ABOVE] = column.count[ANY] = 0;
+    if (!_in_region(INTERIOR, x, z)) return;
+    column.surface = surface;
+    for (int y = 1; y <= WORLD_Y - MAP_CLEAR; y++) {
+        if (world_at(world_terrain, x, y, z) || world_at(world_units, x, y, z))
+            continue;
+        int band = y >= column.surface ? ABOVE : ANY;
+        column.slot[y] = column.count[band];
+        column.cells[band][column.count[band]++] = (uint8) y;
+    }
+    _update_lists(x, z);
+}
+
+void _claim(int x, int y, int z) {
+    Column &column = columns[x][z];
+    const int band = y >= column.surface ? ABOVE : ANY;
+    const int i = column.slot[y];
+    if (i >= column.count[band] || column.cells[band][i] != y) return;
+    uint8 last = column.cells[band][--column.count[band]];
+    column.cells[band][column.slot[y]] = last;
+    column.slot[last] = column.slot[y];
+    _update_lists(x, z);
+}
+
+}
+
+void Unit::index_free_cells() {
+    for (int r = 0; r < REGION_COUNT; r++) {
+        for (int b = 0; b < BAND_COUNT; b++) {
+            regions[r][b].members.clear();
+            regions[r][b].slot.assign(WORLD_XZ * WORLD_XZ, -1);
+        }
+    }
+    for (int x = 0; x < WORLD_XZ; x++)
+        for (int z = 0; z < WORLD_XZ; z++)
+            _index_column(x, z, calc_min_y(x, z));
+    indexed = true;
+}
+
+void Unit::index_free_cells(int x0, int z0, int x1, int z1) {
+    // columns keep their list slots, so only those in the box need redoing
+    if (!indexed) {
+        index_free_cells();
+        return;
+    }
+    for (int x = max(x0, 0); x < x1 && x < WORLD_XZ; x++)
+        for (int z = max(z0, 0); z < z1 && z < WORLD_XZ; z++)
+            _index_column(x, z, calc_min_y(x, z));
+}
+
+coordinate Unit::calc_random_coordinate(
+    bool edge, bool above_terrain, bool claim
+) {
+    if (!indexed) index_free_cells();
+    const Band band = above_terrain ? ABOVE : ANY;
+    const vector<int> &members = regions[edge ? EDGE : INTERIOR][band].members;
+    if (members.empty()) {
+        log_warn("no free %s cells left", edge ? "edge" : "interior");
+        return {WORLD_XZ / 2, WORLD_Y - MAP_CLEAR, WORLD_XZ / 2};
+    }
+    Coordinate c = {0, 0, 0};
+    // cells are only claimed by spawns so moving units may still be in the
+    // way; retry a bounded number of times rather than scanning
+    for (int attempt = 0; attempt < SPAWN_ATTEMPTS; attempt++) {
+        const int id = members[_gen_index(members.size())];
+        c.x = id / WORLD_XZ;
+        c.z = id % WORLD_XZ;
+        const Column &column = columns[c.x][c.z];
+        size_t i = _gen_index(_band_count(column, band));
+        c.y = i < column.count[ABOVE]
+            ? column.cells[ABOVE][i]
+            : column.cells[ANY][i - column.count[ABOVE]];
+        if (!world_at(world_units, c.x, c.y, c.z)) break;
+    }
+    if (claim) _claim(c.x, c.y, c.z);
+    return c;
+}